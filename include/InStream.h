@@ -51,6 +51,13 @@ namespace parsley {
 /// All method calls are forwarded to the equivalent methods in the contained 
 /// input stream instance.
 /// Only @c get @c unget @c peek @c tellg and @c seekg are implemented.
+/// The get pointer position is tracked internally: @c tellg does not invoke
+/// the contained stream's @c tellg method.
+/// Checkpoints are created with @c mark and restored with @c reset: restoring
+/// a checkpoint does not require any search in the end of line list.
+/// A cut, set through @c cut, prevents moving back before the current 
+/// position: any such attempt is ignored and recorded as a failure, 
+/// see @c cut_failed.
 /// @tparam IT input stream e.g. @c std::istream
 /// @tparam RESIZE_THRESHOLD max number of end of line separators to keep in 
 ///         memory
@@ -66,9 +73,10 @@ public:
     ///@param f filter: proceed until function does not return true
     template < typename F >
     InChStream( IT& is, const F& f) :
-                            isp_( &is ), lines_( 0 ),
+                            isp_( &is ), pos_( 0 ), lines_( 0 ),
                             lineChars_( 0 ), eolIt_( eols_.begin() ),
                             locale_( is.getloc() ), gets_(0), ungets_(0),
+                            marks_(0), cutPos_(0), cutFailed_(false),
                             filter_(f) {
 #ifndef BUFFERED_IN_STREAM
         ///@warning required on MS Windows with VC++, issues in istreams require
@@ -77,6 +85,8 @@ public:
         assert( is.rdbuf() && "NULL rdbuf" );   
         is.rdbuf()->pubsetbuf( 0, 0 );
 #endif
+        const streamoff p = is.tellg();
+        if( p > 0 ) pos_ = p;
     }
     InChStream(IT& is) :
         InChStream(is, [](typename IT::char_type ) { return false; }) {}
@@ -84,6 +94,12 @@ public:
     typedef typename IT::streampos streampos;
     typedef typename IT::streamoff streamoff;
     typedef std::deque< streamoff > EOLs;
+    /// Checkpoint: position, line and character in line.
+    struct Mark {
+        streamoff pos;
+        int lines;
+        int lineChars;
+    };
     /// Returns current char and moves get pointer to next character.
     /// @return current char in stream buffer.
     /// @throw std::logic_error if stream @c good bit @b not set.
@@ -93,9 +109,11 @@ public:
         char_type c = 0;
         if( isp_->good() ) {
             c = isp_->get();
-            while(isp_->good()
-                  && filter_(c)) c = get();
-            
+            if( !isp_->fail() ) ++pos_;
+            while( isp_->good() && filter_( c ) ) {
+                c = isp_->get();
+                if( !isp_->fail() ) ++pos_;
+            }
         } else {
             throw std::logic_error( "Attempt to read from invalid stream" );
             return c; // in case exception handling disabled
@@ -103,7 +121,7 @@ public:
         if( c == EOL_ ) {
             ++lines_;
             lineChars_ = 0;
-            eols_.push_back( streamoff( isp_->tellg() ) - 1 );
+            eols_.push_back( pos_ - 1 );
         }
         else ++lineChars_;
         // this is to ensure that the eol list doesn't get too big, could
@@ -135,11 +153,12 @@ public:
         isp_->clear();
     }
 
-    /// Returns current get pointer position.
+    /// Returns current get pointer position; as with @c std::istream the 
+    /// returned value is -1 if the @c fail bit is set.
     /// @return get pointer position.
     streampos tellg() {
         assert( isp_ != 0 && "NULL STREAM POINTER" );
-        return isp_->tellg();
+        return isp_->fail() ? streampos( -1 ) : streampos( pos_ );
     }
 
     /// Moves get pointer to the specified position. In case of forward movement
@@ -148,21 +167,83 @@ public:
     /// @return reference to stream
     IT& seekg( streampos p ) {
         assert( isp_ != 0 && "NULL STREAM POINTER" );
-        if( isp_->tellg() == p ) return *isp_;
+        if( !isp_->fail() && pos_ == streamoff( p ) ) return *isp_;
         if( !isp_->good() ) clear();
-        
-        if( isp_->tellg() > p ) BackwardSeek( p );
+        if( streamoff( p ) < cutPos_ ) {
+            cutFailed_ = true;
+            return *isp_;
+        }
+        if( pos_ > streamoff( p ) ) BackwardSeek( p );
         else ForwardSeek( p );
         
         return *isp_;
     }
 
+    /// Records a checkpoint. Each checkpoint should be released through
+    /// @c release when not needed anymore: the number of outstanding 
+    /// checkpoints is available through @c marks; if zero no data before
+    /// the current position is going to be accessed through @c reset.
+    /// @return checkpoint
+    Mark mark() {
+        ++marks_;
+        const Mark m = { pos_, lines_, lineChars_ };
+        return m;
+    }
+
+    /// Moves get pointer back to checkpoint and clears bits; the end of line
+    /// list and line counters are restored from the checkpoint.
+    /// @param m checkpoint returned by @c mark
+    void reset( const Mark& m ) {
+        assert( isp_ != 0 && "NULL STREAM POINTER" );
+        clear();
+        if( m.pos < cutPos_ ) {
+            cutFailed_ = true;
+            return;
+        }
+        if( pos_ != m.pos ) {
+            isp_->seekg( m.pos );
+            pos_ = m.pos;
+        }
+        while( !eols_.empty() && eols_.back() >= m.pos ) eols_.pop_back();
+        lines_ = m.lines;
+        lineChars_ = m.lineChars;
+    }
+
+    /// Releases checkpoint.
+    void release( const Mark& ) {
+        assert( marks_ > 0 );
+        --marks_;
+    }
+
+    /// Returns number of outstanding checkpoints.
+    int marks() const { return marks_; }
+
+    /// Sets a cut at the current position: the get pointer cannot be moved
+    /// back before the cut and the end of line positions before the cut are 
+    /// discarded.
+    void cut() {
+        cutPos_ = pos_;
+        if( eols_.size() > 1 ) eols_.erase( eols_.begin(), eols_.end() - 1 );
+    }
+
+    /// Returns @c true if an attempt to move back before the last cut was 
+    /// made: parsers use this information to turn failures after a cut into
+    /// hard failures, not handled by alternative parsers.
+    bool cut_failed() const { return cutFailed_; }
+
+    /// Removes cut and clears cut failure.
+    void cut_clear() {
+        cutPos_ = 0;
+        cutFailed_ = false;
+    }
+
     /// Move back get pointer.
     void unget() {
         assert( isp_ != 0 && "NULL STREAM POINTER" );
-        if( streamoff( isp_->tellg() ) == 0  ) return;
+        if( pos_ == 0  ) return;
         clear(); //make unget work after eof is reached
         isp_->unget();
+        --pos_;
         const char_type  PEEKED = isp_->peek();
         if( PEEKED == EOL_ ) {
             --lines_;
@@ -170,8 +251,8 @@ public:
             eols_.erase( eolIt_, eols_.end() );
         }
         ++ungets_;
-        if( eols_.empty() ) lineChars_ = int(isp_->tellg());
-        else lineChars_ = int( isp_->tellg() - eols_.back() );
+        if( eols_.empty() ) lineChars_ = int( pos_ );
+        else lineChars_ = int( pos_ - eols_.back() );
     }
 
     /// Returns @c good bit.
@@ -215,22 +296,24 @@ private:
     void BackwardSeek( streampos p ) {
         assert( isp_ != 0 && "NULL STREAM POINTER" );
         isp_->seekg( p );
+        pos_ = p;
         const streamoff sp = p; 
         reolIt_ = std::find_if( eols_.rbegin(), eols_.rend(),
                     std::bind1st( std::greater< streamoff >(), sp ) );
-        if( reolIt_ == eols_.rend() ) return;
         eolIt_ = reolIt_.base(); //reverse to forward iterator
+        lines_ -= int( eols_.end() - eolIt_ );
         eols_.erase( eolIt_, eols_.end() );
-        lines_ = int(eols_.size());
-        if( !eols_.empty() ) lineChars_ = int( p - eols_.back() ); 
+        lineChars_ = int( eols_.empty() ? sp : sp - eols_.back() ); 
     }
     /// Seek forward. Called by seekg().
     void ForwardSeek( streampos p ) {
         assert( isp_ != 0 && "NULL STREAM POINTER" );
-        while( !isp_->bad() && isp_->tellg() != p ) get();
+        while( !isp_->bad() && pos_ != streamoff( p ) ) get();
     }
     /// Pointer to input stream. Life cycle is handled outside this class.
     IT* isp_;
+    /// Current get pointer position.
+    streamoff pos_;
     /// Number of line separators read.
     int lines_;
     /// Number of characters read in current line.
@@ -251,6 +334,12 @@ private:
     int gets_;
     ///Total number of unget() operations
     int ungets_;
+    ///Number of outstanding checkpoints
+    int marks_;
+    ///Position of last cut
+    streamoff cutPos_;
+    ///Set when trying to move back before last cut
+    bool cutFailed_;
     ///Filter characters
     std::function< bool (char_type) > filter_;
 };
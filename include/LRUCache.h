@@ -0,0 +1,110 @@
+#pragma once
+//Thread-safe least recently used cache
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace parsley {
+
+///Least recently used cache with a memory cap.
+///Each entry is inserted together with its size in bytes; when the total
+///size exceeds the capacity the least recently used entries are evicted.
+///Values are returned as shared pointers to const, an evicted value stays
+///valid as long as it is referenced.
+///All the methods can be invoked concurrently from multiple threads.
+///@code
+///LRUCache< string, AST > cache(1 << 20);
+///auto a = cache.Find(expr);
+///if(!a) a = cache.Insert(expr, Parse(expr), size);
+///@endcode
+template < typename KeyT, typename ValueT,
+           typename HashT = std::hash< KeyT > >
+class LRUCache {
+public:
+    using ValuePtr = std::shared_ptr< const ValueT >;
+    ///Constructor: @c capacity is the maximum total size in bytes.
+    LRUCache(std::size_t capacity) : capacity_(capacity) {}
+    LRUCache(const LRUCache&) = delete;
+    LRUCache& operator=(const LRUCache&) = delete;
+    ///Returns value or null pointer if key not found; found entries become
+    ///the most recently used ones.
+    ValuePtr Find(const KeyT& k) {
+        std::lock_guard< std::mutex > lock(mutex_);
+        auto i = index_.find(k);
+        if(i == index_.end()) {
+            ++misses_;
+            return ValuePtr();
+        }
+        ++hits_;
+        entries_.splice(entries_.begin(), entries_, i->second);
+        return i->second->value;
+    }
+    ///Inserts or replaces value, returns pointer to inserted value.
+    ///Values larger than the capacity are returned but not stored.
+    ValuePtr Insert(const KeyT& k, ValueT v, std::size_t size) {
+        ValuePtr p = std::make_shared< const ValueT >(std::move(v));
+        std::lock_guard< std::mutex > lock(mutex_);
+        auto i = index_.find(k);
+        if(i != index_.end()) Erase(i);
+        if(size > capacity_) return p;
+        while(size_ + size > capacity_) Erase(index_.find(entries_.back().key));
+        entries_.push_front({k, p, size});
+        index_[k] = entries_.begin();
+        size_ += size;
+        return p;
+    }
+    void Clear() {
+        std::lock_guard< std::mutex > lock(mutex_);
+        entries_.clear();
+        index_.clear();
+        size_ = 0;
+    }
+    std::size_t Hits() const {
+        std::lock_guard< std::mutex > lock(mutex_);
+        return hits_;
+    }
+    std::size_t Misses() const {
+        std::lock_guard< std::mutex > lock(mutex_);
+        return misses_;
+    }
+    ///Returns total size of stored values in bytes.
+    std::size_t Size() const {
+        std::lock_guard< std::mutex > lock(mutex_);
+        return size_;
+    }
+    ///Returns number of stored values.
+    std::size_t Count() const {
+        std::lock_guard< std::mutex > lock(mutex_);
+        return entries_.size();
+    }
+    std::size_t Capacity() const { return capacity_; }
+private:
+    struct Entry {
+        KeyT key;
+        ValuePtr value;
+        std::size_t size;
+    };
+    using Entries = std::list< Entry >;
+    using Index =
+        std::unordered_map< KeyT, typename Entries::iterator, HashT >;
+    void Erase(typename Index::iterator i) {
+        size_ -= i->second->size;
+        entries_.erase(i->second);
+        index_.erase(i);
+    }
+private:
+    const std::size_t capacity_;
+    //most recently used first
+    Entries entries_;
+    Index index_;
+    std::size_t size_ = 0;
+    std::size_t hits_ = 0;
+    std::size_t misses_ = 0;
+    mutable std::mutex mutex_;
+};
+
+}
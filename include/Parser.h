@@ -33,6 +33,7 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <functional>
 #include "types.h"
 #include "Any.h"
 
@@ -59,9 +60,38 @@ struct IParser {
     /// Returns copy of current instance.
     /// @return pointer to newly created instance.
     virtual IParser* Clone() const = 0;
+    /// Declares the values required by client code: parsers whose values
+    /// are not in the set only validate the input during subsequent calls to
+    /// Parse, without storing or converting the parsed text, and return no
+    /// values; composite parsers forward the set to contained parsers.
+    /// Projection cannot be undone: use a fresh copy of the parser to
+    /// extract all the values again.
+    /// The default implementation does nothing.
+    /// @param ids identifiers of required values.
+    virtual void Project( const ValueIDs& /*ids*/ ) {}
     virtual ~IParser() {}
 };
 
+//------------------------------------------------------------------------------
+/// @brief Receives the values extracted by a composite parser as soon as
+/// each element is parsed, instead of having them accumulated in memory.
+///
+/// Returning @c false stops the repetition in progress.
+/// @ingroup MainClasses
+typedef std::function< bool ( const Values& ) > ValueSink;
+
+/// Returns a ValueSink writing each received value map into an output
+/// iterator.
+/// @code
+/// std::vector< Values > records;
+/// MultiParser mp( record );
+/// mp.SetSink( MakeValueSink( std::back_inserter( records ) ) );
+/// @endcode
+template < typename OutputIteratorT >
+ValueSink MakeValueSink( OutputIteratorT out ) {
+    return [out]( const Values& v ) mutable { *out++ = v; return true; };
+}
+
 //------------------------------------------------------------------------------
 /// @brief Implementation of IParser interface.
 ///
@@ -118,8 +148,13 @@ public:
     }
     /// Implementation of IParser::Clone.
     Parser* Clone() const { return new Parser( *this ); }
+    /// Implementation of IParser::Project.
+    void Project( const ValueIDs& ids ) { if( pImpl_ ) pImpl_->Project( ids ); }
     /// Returns @c true if pImpl_ non-null
     bool Valid() const { return pImpl_.get() != 0; }
+    /// Returns contained implementation, can be inspected through
+    /// @c dynamic_cast by code lowering known parsers to other forms.
+    const IParser* Get() const { return pImpl_.get(); }
 
 private:
     /// Check internal pointer to owned IParser instance.
@@ -188,12 +223,46 @@ private:
     IstreamT& is_;
 };
 
+/// @brief RewindManager specialization for InChStream: relies on stream
+/// checkpoints instead of @c tellg and @c seekg.
+template< class IT, unsigned long RESIZE_THRESHOLD, typename IT::char_type EOL_ >
+class RewindManager< InChStream< IT, RESIZE_THRESHOLD, EOL_ > > {
+    /// Stream type.
+    typedef InChStream< IT, RESIZE_THRESHOLD, EOL_ > IstreamT;
+public:
+    /// Constructor. A checkpoint is recorded.
+    /// @param flag monitored value.
+    /// @param is input stream reference to act on.
+    RewindManager( bool& flag, IstreamT& is ) 
+        : mark_( is.mark() ), flag_( flag ), is_( is ) {}
+    /// Destructor: resets the stream to the recorded checkpoint if the
+    /// monitored value is @c false, then releases the checkpoint.
+    ~RewindManager() {
+        if( !flag_ ) is_.reset( mark_ );
+        is_.release( mark_ );
+    }
+    /// @return recorded checkpoint, can be used to reset the stream
+    /// before the manager goes out of scope.
+    typename IstreamT::Mark Mark() const { return mark_; }
+private:
+    /// Checkpoint.
+    const typename IstreamT::Mark mark_;
+    /// Condition flag reference.
+    const bool& flag_;
+    /// Input stream reference.
+    IstreamT& is_;
+};
+
 /// Convenience typedef.
 typedef RewindManager< InStream > REWIND;
 
 //------------------------------------------------------------------------------
 /// @brief Applies a sequence of parsers to the input stream in the order 
 /// supplied by the client code, optionally skipping leading blanks.
+///
+/// Values are not copied while parsing: they are retrieved from the child
+/// parsers on demand and memory usage is bound by the size of one record.
+/// To stream records wrap the parser into a MultiParser with a ValueSink.
 class AndParser : public IParser {
 public:
     typedef Values::value_type::second_type ValueType;
@@ -258,6 +327,12 @@ public:
     
     /// Implementation of IParser::Clone.
     AndParser* Clone() const { return new AndParser( *this ); }
+    /// Implementation of IParser::Project: forwards to all parsers.
+    void Project( const ValueIDs& ids ) {
+        for( Parsers::iterator i = parsers_.begin(); i != parsers_.end(); ++i ) {
+            i->Project( ids );
+        }
+    }
 
 private:
     /// Appends values extracted from child parsers to the value map.
@@ -303,7 +378,17 @@ public:
     ///        If a number < 0 is specifie the parser is invoked until it fails.
     MultiParser( const IParser& p, const ValueID& name = ValueID(), 
                  int countMin = 1, int countMax = -1 ) 
-        : parser_( p ), countMin_( countMin ), countMax_( countMax ) {}
+        : name_( name ), parser_( p ), countMin_( countMin ),
+          countMax_( countMax ), collect_( true ) {}
+    /// Sets sink receiving the values extracted by each invocation of the
+    /// contained parser; when a sink is set values are not stored and
+    /// GetValues returns an empty list. If the sink returns @c false the
+    /// repetition stops.
+    /// Note that in case of failure the stream is rewound but values already
+    /// forwarded to the sink cannot be retracted.
+    /// @param s sink, pass an empty function to restore the default behavior.
+    /// @return reference to @c *this.
+    MultiParser& SetSink( const ValueSink& s ) { sink_ = s; return *this; }
     /// Implementation of IParser::Parse. Invokes the contained parser at least 
     /// MultiParser#countMin_ times, and no more than MultiParser#countMax_ 
     /// times or until parsing fails if  MultiParser#countMax_ < 0.
@@ -313,6 +398,7 @@ public:
     ///    MultiParser#countMax_ times and MultiParser#countMax_ < 0.
     bool Parse( InStream& is ) {
         valueMap_.clear();
+        values_.clear();
         bool ok = false; {
         REWIND r( ok, is );
         int counter = 0;
@@ -320,12 +406,18 @@ public:
                ( counter < countMax_ || countMax_ < 0 ) &&
                parser_.Parse( is ) ) {
             ++counter;
+            if( sink_ ) {
+                if( !sink_( parser_.GetValues() ) ) break;
+                continue;
+            }
+            if( !collect_ ) continue;
             const Values& v = parser_.GetValues();
             for( Values::const_iterator i = v.begin(); i != v.end(); ++i ) {
                 values_.push_back( i->second );
             }
         }
-        if( counter < countMin_ || ( counter > countMax_ && countMax_ >= 0 ) ) {
+        if( counter < countMin_ || ( counter > countMax_ && countMax_ >= 0 ) 
+            || is.cut_failed() ) {
             ok = false;    
         } 
         else ok = true; // counter in [countMin_, countMax_]
@@ -357,6 +449,15 @@ public:
  
     /// Implementation of IParser::Clone.
     MultiParser* Clone() const { return new MultiParser( *this ); }
+    /// Implementation of IParser::Project: if the list of values is not
+    /// required values are not collected and the set is forwarded to the
+    /// contained parser, if it is required the contained parser is left
+    /// untouched since all its values are stored into the list.
+    void Project( const ValueIDs& ids ) {
+        if( ids.find( name_ ) != ids.end() ) return;
+        collect_ = false;
+        parser_.Project( ids );
+    }
 
 private:
     /// Identifier for parsed value list in returned value map.
@@ -376,6 +477,10 @@ private:
     /// List of parsed values. Values are appended to list after each invocation
     /// of MultiParser#parser_.Parse().
     std::list< Any > values_;   
+    /// Optional sink receiving values in place of MultiParser#values_.
+    ValueSink sink_;
+    /// If @c false values are not stored, see MultiParser::Project.
+    bool collect_;
 };
 
 /// Convenience operator to mimic regex syntax and generate a multiparser
@@ -411,17 +516,25 @@ public:
         // validate
         valueMap_.clear();
         String s;
+        String::size_type length = 0;
         Char c = 0;
         StreamPos pos = is.tellg();
         while( is.good() && !parser_.Parse( is ) ) {
             c = is.get();
             if( !is.good() ) break;
-            s.push_back( c );
+            if( !validateOnly_ ) s.push_back( c );
+            ++length;
             pos = is.tellg();
         }
         if( is.good() ) is.seekg( pos );
         if( s.length() > 0 ) valueMap_.insert( std::make_pair( name_, s ) );
-        return s.length() > 0;
+        return length > 0;
+    }
+    /// Implementation of IParser::Project: the values of the contained
+    /// parser are never used.
+    void Project( const ValueIDs& ids ) {
+        validateOnly_ = ids.find( name_ ) == ids.end();
+        parser_.Project( ValueIDs() );
     }
 
     /// Implementation of IParser::operator[].
@@ -434,12 +547,13 @@ public:
     }
     /// (Default) constructor.
     /// @param name key indentifier for parsed text. 
-    NotParser( const ValueID& name = ValueID() ) : name_( name ) {}
+    NotParser( const ValueID& name = ValueID() ) 
+        : name_( name ), validateOnly_( false ) {}
     /// Constructor. Allows for construction from any value that can be used to 
     /// construct the contained parser type.
     template < class T > NotParser( const T& v, 
                                     const ValueID& name = ValueID() ) 
-        : parser_( v ), name_( name ) {}
+        : parser_( v ), name_( name ), validateOnly_( false ) {}
 private:
     /// Contained parser.
     ParserT parser_;
@@ -447,6 +561,8 @@ private:
     Values valueMap_;
     /// Value identifier used as key in value map.
     ValueID name_;
+    /// If @c true parsed text is not stored.
+    bool validateOnly_;
 };
 
 
@@ -466,11 +582,14 @@ public:
     /// the parsed characters.
     const Values& GetValues() const { return valueMap_; }
     OptionalParser* Clone() const { return new OptionalParser( *this ); }
-    /// Implementation of IParser::Parse: apply parser and always returns true.
+    /// Implementation of IParser::Project.
+    void Project( const ValueIDs& ids ) { parser_.Project( ids ); }
+    /// Implementation of IParser::Parse: apply parser and always returns true
+    /// unless the contained parser failed after a cut.
     bool Parse( InStream& is ) {
         valueMap_.clear();
         if( parser_.Parse( is ) ) valueMap_ = parser_.GetValues();
-        return true;
+        return !is.cut_failed();
     }
     /// Implementation of IParser::operator[].
     /// @exception std::logic error if key not found.
@@ -529,11 +648,16 @@ public:
         matchedParser_ = parsers_.end();
         bool ok = false; {
         REWIND r( ok, is );
+        const InStream::Mark m = r.Mark();
         Parsers::iterator i = parsers_.begin();
         for( ; i != parsers_.end(); ++i ) {
-            const StreamPos pos = is.tellg();
             if( !i->Parse( is ) ) {
-                is.seekg( pos );
+                is.reset( m );
+                // failure after cut: do not try other alternatives
+                if( is.cut_failed() ) {
+                    i = parsers_.end();
+                    break;
+                }
                 continue;
             }
             else break;
@@ -561,6 +685,12 @@ public:
 
     /// Implemetation of IParser::Clone.
     OrParser* Clone() const { return new OrParser( *this ); }
+    /// Implementation of IParser::Project: forwards to all parsers.
+    void Project( const ValueIDs& ids ) {
+        for( Parsers::iterator i = parsers_.begin(); i != parsers_.end(); ++i ) {
+            i->Project( ids );
+        }
+    }
 
 private:
     /// Parser list type.
@@ -614,7 +744,11 @@ public:
                 matchedParsers_.insert( std::make_pair( is.tellg(), i ) );
             }
             is.seekg( pos );
-
+            // cut in alternative: no other alternative can be tried
+            if( is.cut_failed() ) {
+                matchedParsers_.clear();
+                return false;
+            }
         }
         matchedParser_ = matchedParsers_.empty() ? 
                          parsers_.end() : ( --matchedParsers_.end() )->second;
@@ -640,6 +774,12 @@ public:
     }
     /// Implementation of IParser::Clone.
     GreedyOrParser* Clone() const { return new GreedyOrParser( *this ); }
+    /// Implementation of IParser::Project: forwards to all parsers.
+    void Project( const ValueIDs& ids ) {
+        for( Parsers::iterator i = parsers_.begin(); i != parsers_.end(); ++i ) {
+            i->Project( ids );
+        }
+    }
 private:
     /// Parser list type.
     typedef std::list< Parser > Parsers;
@@ -675,7 +815,7 @@ public:
         bool ok = !( terminalParser_.Valid() && terminalParser_.Parse( is ) )
                   && parser_.Parse( is );
         REWIND r( ok, is ); 
-        while( !ok && !is.eof() ) {
+        while( !ok && !is.eof() && !is.cut_failed() ) {
             if( skipBlanks_ ) {
                 InStream::char_type c = is.get();
                 while( IsSpace( c ) && !is.eof() ) c = is.get();
@@ -703,6 +843,12 @@ public:
     
     /// Implementation of IParser::Clone.
     GreedyParser* Clone() const { return new GreedyParser( *this ); }
+    /// Implementation of IParser::Project: the values of the terminal parser
+    /// are never used.
+    void Project( const ValueIDs& ids ) {
+        parser_.Project( ids );
+        if( terminalParser_.Valid() ) terminalParser_.Project( ValueIDs() );
+    }
 
 private:
     /// Parser list.
@@ -711,9 +857,37 @@ private:
     bool skipBlanks_;
 };
 
+//------------------------------------------------------------------------------
+/// @brief Cut: once applied the input stream cannot be moved back before 
+/// the current position.
+///
+/// Any failure after the cut is a hard failure: enclosing alternatives are 
+/// not tried and enclosing optional or repeated parsers fail. Memory used to 
+/// track the input before the cut, e.g. end of line positions, is released.
+/// Use InStream::cut_clear to resume parsing after a hard failure.
+class CutParser : public IParser {
+public:
+    typedef Values::value_type::second_type ValueType;
+    typedef Values::key_type KeyType;
+    /// Implementation of IParser::Parse: sets cut and returns @c true.
+    bool Parse( InStream& is ) { is.cut(); return true; }
+    /// Implementation of IParser::GetValues.
+    /// @return empty map
+    const Values& GetValues() const { static const Values v; return v; }
+    /// Implementation of IParser::operator[].
+    /// @exception std::logic_error always.
+    const ValueType& operator[]( const KeyType& ) const {
+        throw std::logic_error( "Cannot find value" );
+    }
+    /// Implementation of IParser::Clone.
+    CutParser* Clone() const { return new CutParser( *this ); }
+};
+
 //==============================================================================
 // RECURSIVE & CALLBACK PARSERS
 //==============================================================================
+// Note: IParser::Project is not forwarded by these parsers: referenced parsers
+// can be shared and callbacks are passed all the values.
 //------------------------------------------------------------------------------
 class RefParser : public IParser {
 public:
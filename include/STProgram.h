@@ -0,0 +1,665 @@
+#pragma once
+//Postfix programs compiled from syntax trees
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <map>
+#include <vector>
+#if defined(__AVX512F__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+#include "STree.h"
+
+namespace parsley {
+
+///Arithmetic operation performed by a node, used by CompileEval to replace
+///calls to binary functions with built-in operations which are vectorized
+///by Program::RunBatch.
+enum class ARITH {NONE, ADD, SUB, MUL, DIV};
+
+//element-wise a[i] = a[i] op b[i], i in [0, n)
+#define PARSLEY_BATCH_OP(NAME, OP, AVX512, AVX) \
+template < typename T > \
+void NAME(T* a, const T* b, std::size_t n) { \
+    for(std::size_t i = 0; i != n; ++i) a[i] = a[i] OP b[i]; \
+} \
+inline void NAME(double* a, const double* b, std::size_t n) { \
+    std::size_t i = 0; \
+    PARSLEY_BATCH_LOOP(AVX512, AVX) \
+    for(; i != n; ++i) a[i] = a[i] OP b[i]; \
+}
+#if defined(__AVX512F__)
+#define PARSLEY_BATCH_LOOP(AVX512, AVX) \
+    for(; i + 8 <= n; i += 8) \
+        _mm512_storeu_pd(a + i, AVX512(_mm512_loadu_pd(a + i), \
+                                       _mm512_loadu_pd(b + i)));
+#elif defined(__AVX__)
+#define PARSLEY_BATCH_LOOP(AVX512, AVX) \
+    for(; i + 4 <= n; i += 4) \
+        _mm256_storeu_pd(a + i, AVX(_mm256_loadu_pd(a + i), \
+                                    _mm256_loadu_pd(b + i)));
+#else
+#define PARSLEY_BATCH_LOOP(AVX512, AVX)
+#endif
+PARSLEY_BATCH_OP(BatchAdd, +, _mm512_add_pd, _mm256_add_pd)
+PARSLEY_BATCH_OP(BatchSub, -, _mm512_sub_pd, _mm256_sub_pd)
+PARSLEY_BATCH_OP(BatchMul, *, _mm512_mul_pd, _mm256_mul_pd)
+PARSLEY_BATCH_OP(BatchDiv, /, _mm512_div_pd, _mm256_div_pd)
+#undef PARSLEY_BATCH_LOOP
+#undef PARSLEY_BATCH_OP
+
+///Linear postfix program evaluated by a stack machine.
+///Programs are generated from a syntax tree by CompileEval, which reproduces
+///the evaluation order of WTree::Eval, or by CompileScopedApply, which
+///reproduces a ScopedApply traversal with a visitor that pushes values at
+///BEGIN and applies n-ary functions to the values of the children at END.
+///Functions are resolved at compile time and stored as pointers: function
+///maps and bound variables must outlive the program.
+///The evaluation stack is sized at compile time: Run does not allocate.
+///RunBatch evaluates the program over columns of slot values, in chunks of
+///BATCH_SIZE rows; built-in arithmetic operations are vectorized with
+///AVX-512 or AVX when enabled at compile time, functions are invoked once
+///per row and must not depend on the order in which rows are evaluated.
+///Optimize folds constant subexpressions and evaluates identical
+///subexpressions once; instructions invoking functions take part in the
+///optimization only when marked as pure.
+///Programs can also be built one instruction at a time, e.g. from parser
+///callbacks: STORE instructions write the value on top of the stack into
+///the output slot array passed to Run and are ignored by RunBatch.
+///@code
+///auto p = CompileEval(ast.GetTree(), ops, [](const Term& t) {
+///    return t.type == VAR ? int(t.value) : -1;
+///});
+///for(auto& v: values) r += p.Run(v.data());
+///@endcode
+template < typename DataT,
+           typename BinaryFunT = std::function< DataT (DataT, DataT) >,
+           typename NaryFunT =
+               std::function< DataT (const std::vector< DataT >&) > >
+class Program {
+public:
+    using Value = DataT;
+    using BinaryFun = BinaryFunT;
+    using NaryFun = NaryFunT;
+    using Args = std::vector< DataT >;
+    ///Operation codes.
+    enum OpCode : unsigned char {
+        PUSH, //push value
+        LOAD, //push slots[a]
+        REF,  //push *ref
+        LEAF, //push bf(value, init)
+        FOLD, //pop b, a; push bf(a, b)
+        CALL, //pop a values; push nf(values)
+        ADD,  //pop b, a; push a + b
+        SUB,  //pop b, a; push a - b
+        MUL,  //pop b, a; push a * b
+        DIV,  //pop b, a; push a / b
+        SAVE, //temps[a] <- top
+        TEMP, //push temps[a]
+        STORE //out[a] <- top
+    };
+    ///Rows per chunk in batch evaluation.
+    enum : std::size_t { BATCH_SIZE = 256 };
+    ///Instruction; @c pure is true if the result only depends on the
+    ///operands, PUSH, LOAD and arithmetic instructions are pure by default.
+    struct Instruction {
+        OpCode op;
+        int a;
+        bool pure;
+        DataT value;
+        DataT init;
+        union {
+            const DataT* ref;
+            const BinaryFunT* bf;
+            const NaryFunT* nf;
+        };
+    };
+    using Code = std::vector< Instruction >;
+    static Instruction Push(const DataT& v) {
+        Instruction i = Make(PUSH);
+        i.value = v;
+        return i;
+    }
+    static Instruction Load(int slot) {
+        Instruction i = Make(LOAD);
+        i.a = slot;
+        return i;
+    }
+    static Instruction Ref(const DataT* r) {
+        Instruction i = Make(REF);
+        i.ref = r;
+        return i;
+    }
+    static Instruction Leaf(const BinaryFunT* f, const DataT& v,
+                            const DataT& init) {
+        Instruction i = Make(LEAF);
+        i.bf = f;
+        i.value = v;
+        i.init = init;
+        return i;
+    }
+    static Instruction Fold(const BinaryFunT* f) {
+        Instruction i = Make(FOLD);
+        i.bf = f;
+        return i;
+    }
+    static Instruction Arith(ARITH a) {
+        assert(a != ARITH::NONE);
+        static const OpCode ops[] = {ADD, ADD, SUB, MUL, DIV};
+        return Make(ops[int(a)]);
+    }
+    static Instruction Store(int slot) {
+        Instruction i = Make(STORE);
+        i.a = slot;
+        return i;
+    }
+    ///Argument count is set when the instruction is added to the program.
+    static Instruction Call(const NaryFunT* f) {
+        Instruction i = Make(CALL);
+        i.nf = f;
+        return i;
+    }
+    ///Appends instruction, updates stack and argument array sizes.
+    void Append(const Instruction& i) {
+        switch(i.op) {
+        case FOLD:
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+            assert(depth_ > 1);
+            --depth_;
+            break;
+        case CALL:
+            assert(depth_ >= i.a);
+            depth_ -= i.a - 1;
+            if(args_.capacity() < std::size_t(i.a)) args_.reserve(i.a);
+            break;
+        case SAVE:
+            assert(depth_ > 0);
+            if(temps_.size() <= std::size_t(i.a)) temps_.resize(i.a + 1);
+            break;
+        case STORE:
+            assert(depth_ > 0);
+            break;
+        default:
+            ++depth_;
+            break;
+        }
+        code_.push_back(i);
+        if(stack_.size() <= std::size_t(depth_)) stack_.resize(depth_ + 1);
+    }
+    ///Removes all instructions, allocated memory is kept.
+    void Clear() {
+        code_.clear();
+        depth_ = 0;
+    }
+    ///Executes program, LOAD instructions read from @c slots, STORE
+    ///instructions write to @c out.
+    ///Returns the first value on the stack.
+    DataT Run(const DataT* slots = nullptr, DataT* out = nullptr) {
+        assert(!code_.empty());
+        //top of the stack is kept in a local variable, values below are
+        //stored from stack_[1]: stack_[0] receives the initial value of top
+        DataT* sp = stack_.data();
+        DataT top = DataT();
+        for(const Instruction& i: code_) {
+            switch(i.op) {
+            case PUSH:
+                *sp++ = top;
+                top = i.value;
+                break;
+            case LOAD:
+                *sp++ = top;
+                top = slots[i.a];
+                break;
+            case REF:
+                *sp++ = top;
+                top = *i.ref;
+                break;
+            case LEAF:
+                *sp++ = top;
+                top = (*i.bf)(i.value, i.init);
+                break;
+            case FOLD:
+                top = (*i.bf)(*--sp, top);
+                break;
+            case CALL:
+                *sp = top;
+                args_.assign(sp + 1 - i.a, sp + 1);
+                sp -= i.a - 1;
+                top = (*i.nf)(args_);
+                break;
+            case ADD:
+                top = *--sp + top;
+                break;
+            case SUB:
+                top = *--sp - top;
+                break;
+            case MUL:
+                top = *--sp * top;
+                break;
+            case DIV:
+                top = *--sp / top;
+                break;
+            case SAVE:
+                temps_[i.a] = top;
+                break;
+            case TEMP:
+                *sp++ = top;
+                top = temps_[i.a];
+                break;
+            case STORE:
+                out[i.a] = top;
+                break;
+            }
+        }
+        *sp = top;
+        return stack_[1];
+    }
+    ///Evaluates program for @c n rows: LOAD instructions read element
+    ///@c row of column @c columns[slot], result is stored into @c out[row].
+    void RunBatch(const DataT* const* columns, DataT* out, std::size_t n) {
+        assert(!code_.empty());
+        const std::size_t B = BATCH_SIZE;
+        //one chunk per stack level and temporary, allocated on first
+        //invocation only
+        const std::size_t size = (stack_.size() + temps_.size()) * B;
+        if(batch_.size() < size) batch_.resize(size);
+        DataT* const temps = batch_.data() + stack_.size() * B;
+        for(std::size_t row = 0; row < n; row += B) {
+            const std::size_t k = std::min(B, n - row);
+            DataT* sp = batch_.data();
+            for(const Instruction& i: code_) {
+                switch(i.op) {
+                case PUSH:
+                    std::fill(sp, sp + k, i.value);
+                    sp += B;
+                    break;
+                case LOAD:
+                    std::copy(columns[i.a] + row, columns[i.a] + row + k, sp);
+                    sp += B;
+                    break;
+                case REF:
+                    std::fill(sp, sp + k, *i.ref);
+                    sp += B;
+                    break;
+                case LEAF:
+                    for(std::size_t j = 0; j != k; ++j)
+                        sp[j] = (*i.bf)(i.value, i.init);
+                    sp += B;
+                    break;
+                case FOLD: {
+                    sp -= B;
+                    DataT* a = sp - B;
+                    for(std::size_t j = 0; j != k; ++j)
+                        a[j] = (*i.bf)(a[j], sp[j]);
+                    break;
+                }
+                case CALL:
+                    sp -= i.a * B;
+                    for(std::size_t j = 0; j != k; ++j) {
+                        args_.clear();
+                        for(int a = 0; a != i.a; ++a)
+                            args_.push_back(sp[a * B + j]);
+                        sp[j] = (*i.nf)(args_);
+                    }
+                    sp += B;
+                    break;
+                case ADD:
+                    sp -= B;
+                    BatchAdd(sp - B, sp, k);
+                    break;
+                case SUB:
+                    sp -= B;
+                    BatchSub(sp - B, sp, k);
+                    break;
+                case MUL:
+                    sp -= B;
+                    BatchMul(sp - B, sp, k);
+                    break;
+                case DIV:
+                    sp -= B;
+                    BatchDiv(sp - B, sp, k);
+                    break;
+                case SAVE:
+                    std::copy(sp - B, sp - B + k, temps + i.a * B);
+                    break;
+                case TEMP:
+                    std::copy(temps + i.a * B, temps + i.a * B + k, sp);
+                    sp += B;
+                    break;
+                case STORE:
+                    break;
+                }
+            }
+            std::copy(batch_.data(), batch_.data() + k, out + row);
+        }
+    }
+    ///Replaces pure instructions whose operands are all constant with their
+    ///value and shares identical pure subexpressions: the first occurrence
+    ///is saved into a temporary, read back by the following ones.
+    ///The order of impure instructions is preserved, LOAD instructions are
+    ///not shared in programs with STORE instructions; must be invoked
+    ///once, after the last instruction is appended.
+    void Optimize() {
+        //value numbering: one node per distinct pure expression
+        struct Node {
+            Instruction i;
+            std::vector< int > args;
+            bool pure;
+            bool constant;
+            int uses;
+            int temp;
+        };
+        std::vector< Node > nodes;
+        std::map< Key, int > index;
+        std::vector< int > stack;
+        std::vector< DataT > values;
+        bool stores = false;
+        for(const Instruction& c: code_) stores = stores || c.op == STORE;
+        for(const Instruction& c: code_) {
+            assert(c.op != SAVE && c.op != TEMP);
+            Instruction i = c;
+            const int arity = Arity(i);
+            assert(int(stack.size()) >= arity);
+            std::vector< int > args(stack.end() - arity, stack.end());
+            stack.resize(stack.size() - arity);
+            bool pure = i.pure && !(stores && i.op == LOAD);
+            bool constant = pure && i.op != LOAD && i.op != REF;
+            for(auto a: args) {
+                pure = pure && nodes[a].pure;
+                constant = constant && nodes[a].constant;
+            }
+            if(constant && i.op != PUSH) {
+                values.clear();
+                for(auto a: args) values.push_back(nodes[a].i.value);
+                i = Push(Evaluate(i, values));
+                args.clear();
+            }
+            const Key k = MakeKey(i, args);
+            auto n = pure && k.shared ? index.find(k) : index.end();
+            if(n != index.end()) {
+                stack.push_back(n->second);
+                continue;
+            }
+            for(auto a: args) ++nodes[a].uses;
+            nodes.push_back({i, args, pure, constant, 0, -1});
+            const int id = int(nodes.size()) - 1;
+            if(pure && k.shared) index[k] = id;
+            stack.push_back(id);
+        }
+        for(auto r: stack) ++nodes[r].uses;
+        //linearize: operands first, shared nodes evaluated once
+        code_.clear();
+        depth_ = 0;
+        int temps = 0;
+        std::vector< std::pair< int, std::size_t > > visit;
+        for(auto r: stack) {
+            visit.push_back({r, 0});
+            while(!visit.empty()) {
+                Node& n = nodes[visit.back().first];
+                if(n.temp >= 0) {
+                    Instruction t = Make(TEMP);
+                    t.a = n.temp;
+                    Append(t);
+                    visit.pop_back();
+                } else if(visit.back().second != n.args.size()) {
+                    visit.push_back({n.args[visit.back().second++], 0});
+                } else {
+                    Append(n.i);
+                    //values cheaper to reload than to save
+                    const bool load = n.i.op == PUSH || n.i.op == LOAD
+                                      || n.i.op == REF;
+                    if(n.uses > 1 && !load) {
+                        n.temp = temps++;
+                        Instruction t = Make(SAVE);
+                        t.a = n.temp;
+                        Append(t);
+                    }
+                    visit.pop_back();
+                }
+            }
+        }
+    }
+    const Code& GetCode() const { return code_; }
+    ///Returns number of values on the stack after the last instruction.
+    int Depth() const { return depth_; }
+    ///Returns maximum stack depth.
+    std::size_t StackSize() const {
+        return stack_.empty() ? 0 : stack_.size() - 1;
+    }
+    ///Returns number of temporaries used by shared subexpressions.
+    std::size_t TempCount() const { return temps_.size(); }
+private:
+    ///Value numbering key.
+    struct Key {
+        OpCode op;
+        int a;
+        const void* f;
+        DataT value;
+        DataT init;
+        std::vector< int > args;
+        //false if values cannot be compared (NaN)
+        bool shared;
+        bool operator<(const Key& k) const {
+            if(op != k.op) return op < k.op;
+            if(a != k.a) return a < k.a;
+            if(f != k.f) return std::less< const void* >()(f, k.f);
+            if(value < k.value || k.value < value) return value < k.value;
+            if(init < k.init || k.init < init) return init < k.init;
+            return args < k.args;
+        }
+    };
+    static Key MakeKey(const Instruction& i, const std::vector< int >& args) {
+        const bool data = i.op == PUSH || i.op == LEAF;
+        const void* f = nullptr;
+        if(i.op == REF) f = i.ref;
+        else if(i.op == LEAF || i.op == FOLD) f = i.bf;
+        else if(i.op == CALL) f = i.nf;
+        const DataT value = data ? i.value : DataT();
+        const DataT init = data ? i.init : DataT();
+        const bool shared = !(value != value) && !(init != init);
+        return {i.op, i.a, f, value, init, args, shared};
+    }
+    static int Arity(const Instruction& i) {
+        switch(i.op) {
+        case FOLD:
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+            return 2;
+        case STORE:
+            return 1;
+        case CALL:
+            return i.a;
+        default:
+            return 0;
+        }
+    }
+    ///Evaluates instruction with constant operands.
+    static DataT Evaluate(const Instruction& i, const std::vector< DataT >& v) {
+        switch(i.op) {
+        case LEAF:
+            return (*i.bf)(i.value, i.init);
+        case FOLD:
+            return (*i.bf)(v[0], v[1]);
+        case CALL:
+            return (*i.nf)(v);
+        case ADD:
+            return v[0] + v[1];
+        case SUB:
+            return v[0] - v[1];
+        case MUL:
+            return v[0] * v[1];
+        case DIV:
+            return v[0] / v[1];
+        default:
+            return i.value;
+        }
+    }
+    static Instruction Make(OpCode op) {
+        Instruction i;
+        i.op = op;
+        i.a = 0;
+        i.pure = op != REF && op != LEAF && op != FOLD && op != CALL
+                 && op != STORE;
+        i.value = DataT();
+        i.init = DataT();
+        i.ref = nullptr;
+        return i;
+    }
+private:
+    Code code_;
+    int depth_ = 0;
+    std::vector< DataT > stack_;
+    Args args_;
+    std::vector< DataT > temps_;
+    std::vector< DataT > batch_;
+};
+
+///Compiles tree into program computing the same value as WTree::Eval.
+///Leaf nodes for which @c slot returns a non negative index are read from
+///the slot array passed to Program::Run and their function is not invoked.
+///Children of nodes for which @c arith returns an operation other than
+///ARITH::NONE are combined with the built-in operation instead of the
+///node function.
+///Function invocations are marked as pure, see Program::Optimize, for nodes
+///for which @c pure returns true.
+template < typename T, typename W, typename O, typename FunctionMapT,
+           typename SlotF, typename ArithF, typename PureF >
+Program<
+    typename Result< typename FunctionMapT::value_type::second_type >::Type,
+    typename FunctionMapT::value_type::second_type >
+CompileEval(const WTree< T, W, O >& t, const FunctionMapT& fm, SlotF slot,
+            ArithF arith, PureF pure) {
+    using Fun = typename FunctionMapT::value_type::second_type;
+    using ProgramType = Program< typename Result< Fun >::Type, Fun >;
+    using Index = typename WTree< T, W, O >::Index;
+    const Index NIL = WTree< T, W, O >::NIL;
+    struct Frame {
+        Index next;
+        typename ProgramType::Instruction fold;
+        bool first;
+    };
+    ProgramType p;
+    if(t.Empty()) return p;
+    std::vector< Frame > stack;
+    Index n = t.Root();
+    for(;;) {
+        //descend along first children, then emit leaf
+        const Fun* f = nullptr;
+        for(;;) {
+            const T& data = t[n].data;
+            assert(fm.find(GetType(data)) != fm.end());
+            f = &fm.find(GetType(data))->second;
+            const Index c = t[n].first;
+            if(c == NIL) break;
+            const ARITH a = arith(data);
+            typename ProgramType::Instruction fold = a == ARITH::NONE
+                                                     ? ProgramType::Fold(f)
+                                                     : ProgramType::Arith(a);
+            fold.pure = fold.pure || pure(data);
+            stack.push_back({t[c].next, fold, true});
+            n = c;
+        }
+        const T& data = t[n].data;
+        const int s = slot(data);
+        if(s >= 0) p.Append(ProgramType::Load(s));
+        else {
+            auto leaf = ProgramType::Leaf(f, GetData(data), Init(GetType(data)));
+            leaf.pure = pure(data);
+            p.Append(leaf);
+        }
+        //fold into parent, climb up while all children emitted
+        for(;;) {
+            if(stack.empty()) return p;
+            Frame& pf = stack.back();
+            if(!pf.first) p.Append(pf.fold);
+            pf.first = false;
+            if(pf.next != NIL) {
+                n = pf.next;
+                pf.next = t[n].next;
+                break;
+            }
+            stack.pop_back();
+        }
+    }
+}
+
+template < typename T, typename W, typename O, typename FunctionMapT,
+           typename SlotF, typename ArithF >
+Program<
+    typename Result< typename FunctionMapT::value_type::second_type >::Type,
+    typename FunctionMapT::value_type::second_type >
+CompileEval(const WTree< T, W, O >& t, const FunctionMapT& fm, SlotF slot,
+            ArithF arith) {
+    return CompileEval(t, fm, slot, arith, [](const T&) { return false; });
+}
+
+template < typename T, typename W, typename O, typename FunctionMapT,
+           typename SlotF >
+Program<
+    typename Result< typename FunctionMapT::value_type::second_type >::Type,
+    typename FunctionMapT::value_type::second_type >
+CompileEval(const WTree< T, W, O >& t, const FunctionMapT& fm, SlotF slot) {
+    return CompileEval(t, fm, slot, [](const T&) { return ARITH::NONE; });
+}
+
+template < typename T, typename W, typename O, typename FunctionMapT >
+Program<
+    typename Result< typename FunctionMapT::value_type::second_type >::Type,
+    typename FunctionMapT::value_type::second_type >
+CompileEval(const WTree< T, W, O >& t, const FunctionMapT& fm) {
+    return CompileEval(t, fm, [](const T&) { return -1; });
+}
+
+///Compiles tree into program computing the same value as a ScopedApply
+///traversal with a visitor that pushes values into the argument list of the
+///enclosing function at BEGIN and, for function nodes, invokes the function
+///with the argument list of the node at END.
+///@c resolve is invoked on each node in BEGIN order and returns the
+///instruction for the node: a CALL instruction is emitted after the
+///instructions of the children, with the number of children as argument
+///count; any other instruction is emitted before. Set Instruction::pure
+///on returned CALL and REF instructions to enable Program::Optimize.
+template < typename ProgramT, typename T, typename W, typename O,
+           typename ResolveF >
+ProgramT CompileScopedApply(const WTree< T, W, O >& t, ResolveF resolve) {
+    using Index = typename WTree< T, W, O >::Index;
+    using Instruction = typename ProgramT::Instruction;
+    const Index NIL = WTree< T, W, O >::NIL;
+    struct Frame {
+        Index n;
+        Instruction end;
+    };
+    ProgramT p;
+    if(t.Empty()) return p;
+    std::vector< Frame > stack;
+    auto begin = [&](Index n) {
+        Instruction i = resolve(t[n].data);
+        if(i.op == ProgramT::CALL) {
+            i.a = 0;
+            for(Index c = t[n].first; c != NIL; c = t[c].next) ++i.a;
+        } else p.Append(i);
+        stack.push_back({n, i});
+    };
+    begin(t.Root());
+    Index next = t[t.Root()].first;
+    while(!stack.empty()) {
+        if(next != NIL) {
+            begin(next);
+            next = t[next].first;
+        } else {
+            const Frame f = stack.back();
+            stack.pop_back();
+            if(f.end.op == ProgramT::CALL) p.Append(f.end);
+            next = stack.empty() ? NIL : t[f.n].next;
+        }
+    }
+    return p;
+}
+
+}
@@ -34,6 +34,8 @@
 #include <functional>
 #include <type_traits>
 #include <stack>
+#include <map>
+#include <cstdint>
 
 
 namespace parsley {
@@ -50,85 +52,144 @@ struct Result< R (*)(Args...) > {
     using Type = R;
 };
     
+///Weighted tree: all the nodes are stored into a single contiguous array
+///and linked through 32 bit indices; nodes are never removed, the entire
+///tree is released at once by Clear() or by the destructor.
 ///@todo make it an inner class of STree
 template < typename T, typename WeightT = int, typename OffT = WeightT >
 class WTree {
 public:
     using Weight = WeightT;
     using Offset = OffT;
+    using Index = std::uint32_t;
+    ///Null index, used for missing parent, child or sibling.
+    enum : Index { NIL = ~Index(0) };
+    ///Tree node; children are stored as a doubly linked list of siblings
+    ///to allow for constant time append and replacement.
+    struct Node {
+        Node(const T& d, Weight w) : data(d), weight(w), parent(NIL),
+            first(NIL), last(NIL), prev(NIL), next(NIL) {}
+        T data;
+        Weight weight; //children's weight is > current weight
+        Index parent;
+        Index first;
+        Index last;
+        Index prev;
+        Index next;
+    };
 public:
-    WTree(const WTree& t) : data_(t.data_), weight_(t.weight_),
-         parent_(nullptr) {
-        for(auto i: t.children_) {
-            children_.push_back(new WTree(*i));
-            children_.back()->parent_ = this;
-        }
-    }
-    WTree(WTree&& t) : data_(t.data_), weight_(t.weight_), parent_(nullptr) {
-        children_ = std::move(t.children_);
-        for(auto i: children_) {
-            i->parent_ = this;
-        }
+    WTree() = default;
+    ///Adds node as the root of an empty tree, returns node index.
+    Index Add(const T& d, Weight weight) {
+        assert(Empty());
+        root_ = NewNode(d, weight);
+        return root_;
     }
-    WTree() = delete;
-    WTree(const T& d, Weight w) : data_(d), weight_(w), parent_(nullptr) {}
-    WTree* Insert(const T& d, Weight weight, WTree* caller = nullptr) {
-        WTree* ret = nullptr;
-        if(weight > weight_) {
-            if(std::find(children_.begin(), children_.end(), caller)
-               == children_.end()) {
-                children_.push_back(new WTree(d, weight));
-                children_.back()->parent_ = this;
-                ret = children_.back();
-            } else {
-                typename std::vector< WTree* >::iterator i =
-                    std::find(children_.begin(), children_.end(), caller);
-                WTree< T >* p = *i;
-                *i = new WTree(d, weight);
-                (*i)->parent_ = this;
-                (*i)->children_.push_back(p);
-                p->parent_ = *i;
-                ret = *i;
-            }
-        } else {
-            if(parent_) ret = parent_->Insert(d, weight, this);
-            else {
-                parent_ = new WTree(d, weight);
-                parent_->children_.push_back(this);
-                ret = parent_;
+    ///Inserts node starting at node n, returns index of new node:
+    ///walks up the tree until a node with a lower weight is found then
+    ///the new node is added as its last child, if the walk came from a child
+    ///of such node the new node replaces the child and the child becomes
+    ///a child of the new node; if no node with lower weight is found the new
+    ///node becomes the new root.
+    Index Insert(Index n, const T& d, Weight weight) {
+        Index caller = NIL;
+        while(weight <= nodes_[n].weight) {
+            if(nodes_[n].parent == NIL) {
+                const Index p = NewNode(d, weight);
+                Append(p, n);
+                root_ = p;
+                return p;
             }
+            caller = n;
+            n = nodes_[n].parent;
+        }
+        const Index c = NewNode(d, weight);
+        if(caller == NIL) Append(n, c);
+        else {
+            Replace(caller, c);
+            Append(c, caller);
         }
-        return ret;
+        return c;
     }
     //move to node with weight == to
-    WTree* Rewind(Weight w) {
-        if(w >= weight_ || !parent_) return this;
-        else return parent_->Rewind(w);
+    Index Rewind(Index n, Weight w) const {
+        while(w < nodes_[n].weight && nodes_[n].parent != NIL)
+            n = nodes_[n].parent;
+        return n;
     }
+    //all the traversals below use an explicit stack holding one frame per
+    //level of the current path; frames record the next child to visit
     template < typename F >
-    F Apply(F f) {
-        f(data_);
-        for(auto i: children_) i->Apply(f);
+    F Apply(F f) const { return Apply(root_, f); }
+    //each child is visited with a copy of the functor taken after it is
+    //applied to the parent, the returned functor is the one applied to
+    //node n only
+    template < typename F >
+    F Apply(Index n, F f) const {
+        struct Frame {
+            Index next;
+            F f;
+        };
+        std::vector< Frame > stack;
+        f(nodes_[n].data);
+        stack.push_back({nodes_[n].first, f});
+        while(!stack.empty()) {
+            const Index i = stack.back().next;
+            if(i == NIL) {
+                stack.pop_back();
+                continue;
+            }
+            stack.back().next = nodes_[i].next;
+            F g(stack.back().f);
+            g(nodes_[i].data);
+            stack.push_back({nodes_[i].first, std::move(g)});
+        }
         return f;
     }
     //scoped apply: functor is applied to current node first then to children,
     //then to current node again at the end
+    //the same functor object is applied to all the nodes: it must return
+    //a reference to itself or void, lvalues are updated in place and
+    //returned by reference, rvalues are moved into the returned value
     template < typename F >
-    F ScopedApply(F f) {
-        auto a(f(data_, APPLY::BEGIN));
-        for(auto i: children_) a = i->ScopedApply(a);
-        return a(data_, APPLY::END);
+    F ScopedApply(F&& f) const {
+        return ScopedApply(root_, std::forward< F >(f));
+    }
+    template < typename F >
+    F ScopedApply(Index n, F&& f) const {
+        using V = typename std::decay< F >::type;
+        using R = decltype(std::declval< V& >()(std::declval< const T& >(),
+                                                APPLY::BEGIN));
+        static_assert(std::is_same< R, V& >::value
+                      || std::is_void< R >::value,
+                      "scoped visitor must return a reference to itself "
+                      "or void, returned copies are not propagated");
+        std::vector< Index > stack;
+        f(nodes_[n].data, APPLY::BEGIN);
+        stack.push_back(n);
+        Index next = nodes_[n].first;
+        while(!stack.empty()) {
+            if(next != NIL) {
+                f(nodes_[next].data, APPLY::BEGIN);
+                stack.push_back(next);
+                next = nodes_[next].first;
+            } else {
+                const Index i = stack.back();
+                stack.pop_back();
+                f(nodes_[i].data, APPLY::END);
+                next = stack.empty() ? NIL : nodes_[i].next;
+            }
+        }
+        return std::forward< F >(f);
     }
     //functional scoped apply: function is returned which traverses tree when
-    //invoked
+    //invoked; functor is moved into the function, each invocation applies
+    //a copy of it
     template < typename F >
-    std::function< F () > FunScopedApply(F f) {
-        auto g = [f, this]() {
-            auto a(std::move(f(data_, APPLY::BEGIN)));
-            for(auto i: children_) a = i->ScopedApply(a);
-            return a(data_, APPLY::END);
-        };
-        return g;
+    std::function< typename std::decay< F >::type () >
+    FunScopedApply(F&& f) const {
+        using V = typename std::decay< F >::type;
+        return ScopedApplyFun< V >{this, root_, std::forward< F >(f)};
     }
     //Evaluation order:
     //if node has children:
@@ -140,69 +201,144 @@ public:
     template < typename FunctionMapT >
     typename Result<
         typename FunctionMapT::value_type::second_type >::Type
-    Eval(const FunctionMapT& fm)  {
-        using Type = typename FunctionMapT::value_type::first_type;
-        assert(fm.find(GetType(data_)) != fm.end());
-        auto& f = fm.find(GetType(data_))->second;
-        using DataT = typename Result<
-            typename FunctionMapT::value_type::second_type >::Type;
-        DataT r = Init(GetType(data_));
-        if(children_.size() > 0) {
-            r = (*children_.begin())->Eval(fm);
-            typename std::vector< WTree< T >* >::iterator i
-                = children_.begin();
-            ++i;
-            for(; i != children_.end(); ++i) r = f(r, (*i)->Eval(fm));
-        } else r = f(GetData(data_), r);
-        return r;
+    Eval(const FunctionMapT& fm) const { return Eval(root_, fm); }
+    template < typename FunctionMapT >
+    typename Result<
+        typename FunctionMapT::value_type::second_type >::Type
+    Eval(Index n, const FunctionMapT& fm) const {
+        using Fun = typename FunctionMapT::value_type::second_type;
+        using DataT = typename Result< Fun >::Type;
+        struct Frame {
+            Index next;
+            const Fun* f;
+            DataT r;
+            bool first;
+        };
+        std::vector< Frame > stack;
+        for(;;) {
+            //descend along first children, then evaluate leaf
+            const Fun* f = nullptr;
+            for(;;) {
+                const T& data = nodes_[n].data;
+                assert(fm.find(GetType(data)) != fm.end());
+                f = &fm.find(GetType(data))->second;
+                const Index c = nodes_[n].first;
+                if(c == NIL) break;
+                stack.push_back({nodes_[c].next, f, Init(GetType(data)), true});
+                n = c;
+            }
+            const T& data = nodes_[n].data;
+            DataT v = (*f)(GetData(data), Init(GetType(data)));
+            //fold value into parent, climb up while all children evaluated
+            for(;;) {
+                if(stack.empty()) return v;
+                Frame& p = stack.back();
+                p.r = p.first ? v : (*p.f)(p.r, v);
+                p.first = false;
+                if(p.next != NIL) {
+                    n = p.next;
+                    p.next = nodes_[n].next;
+                    break;
+                }
+                v = p.r;
+                stack.pop_back();
+            }
+        }
     }
     //Iterative eval function: at each node the result of children evaluation
     //is stored into array together with data value at current node; function
     //is then called with array
     template < typename FunctionMapT >
-    auto EvalArgs(const FunctionMapT& fm) -> decltype(GetData(T())) {
-        using Type = typename FunctionMapT::value_type::first_type;
-        assert(fm.find(GetType(data_)) != fm.end());
-        auto f = fm.find(GetType(data_))->second;
+    typename Result<
+        typename FunctionMapT::value_type::second_type >::Type
+    EvalArgs(const FunctionMapT& fm) const { return EvalArgs(root_, fm); }
+    template < typename FunctionMapT >
+    typename Result<
+        typename FunctionMapT::value_type::second_type >::Type
+    EvalArgs(Index n, const FunctionMapT& fm) const {
         using DataT = typename Result<
             typename FunctionMapT::value_type::second_type >::Type;
-        std::vector< DataT > args;
-        args.reserve(1 + children_.size());
-        args.push_back(GetData(data_));
-        typename std::vector< WTree< T >* >::iterator i = children_.begin();
-        for(; i != children_.end(); ++i) args.push_back(i->EvalArgs(fm));
-        return Get(GetType(data_), fm)(args);
+        struct Frame {
+            Index n;
+            Index next;
+            std::vector< DataT > args;
+        };
+        std::vector< Frame > stack;
+        auto push = [&](Index i) {
+            const T& data = nodes_[i].data;
+            assert(fm.find(GetType(data)) != fm.end());
+            stack.push_back({i, nodes_[i].first,
+                             std::vector< DataT >(1, GetData(data))});
+        };
+        push(n);
+        for(;;) {
+            Frame& t = stack.back();
+            if(t.next != NIL) {
+                const Index i = t.next;
+                t.next = nodes_[i].next;
+                push(i);
+                continue;
+            }
+            const DataT v = Get(GetType(nodes_[t.n].data), fm)(t.args);
+            stack.pop_back();
+            if(stack.empty()) return v;
+            stack.back().args.push_back(v);
+        }
     }
-    const WTree< T >* Root() const {
-        if(parent_ == nullptr) return this;
-        return parent_->Root();
+    Index Root() const { return root_; }
+    const Node& operator[](Index n) const { return nodes_[n]; }
+    const T& Data(Index n) const { return nodes_[n].data; }
+    bool Empty() const { return nodes_.empty(); }
+    std::size_t Size() const { return nodes_.size(); }
+    void Reserve(std::size_t n) { nodes_.reserve(n); }
+    ///Removes all the nodes, allocated memory is kept for reuse.
+    void Clear() {
+        nodes_.clear();
+        root_ = NIL;
     }
-    WTree< T >* Root() {
-        if(parent_ == nullptr) return this;
-        return parent_->Root();
+private:
+    template < typename F >
+    struct ScopedApplyFun {
+        const WTree* tree;
+        Index root;
+        F f;
+        F operator()() const { return tree->ScopedApply(root, F(f)); }
+    };
+    Index NewNode(const T& d, Weight w) {
+        assert(nodes_.size() < std::size_t(NIL));
+        nodes_.push_back(Node(d, w));
+        return Index(nodes_.size() - 1);
     }
-    const T& Data() const { return data_; }
-    const std::vector< WTree* >& Children() const { return children_; }
-    ~WTree() {
-        for(auto i: children_) delete i;
+    //add c as last child of p
+    void Append(Index p, Index c) {
+        Node& n = nodes_[c];
+        n.parent = p;
+        n.next = NIL;
+        n.prev = nodes_[p].last;
+        if(n.prev != NIL) nodes_[n.prev].next = c;
+        else nodes_[p].first = c;
+        nodes_[p].last = c;
     }
-    //copies tree, it also returns the new address assigned to the copy
-    //of the node passed as a parameter; this is required because in case
-    //a pointer points to a tree node we want to know the address of the
-    //newly created node in the new tree
-    WTree* DeepCopy(WTree* in, WTree*& out) {
-        WTree* p = new WTree(data_, weight_);
-        for(auto i: children_) {
-            p->children_.push_back(i->DeepCopy(in, out));
-        }
-        if(this == in) out = p;
-        return p;
+    //put node r in place of node c in the list of children of c's parent,
+    //c is unlinked
+    void Replace(Index c, Index r) {
+        Node& o = nodes_[c];
+        Node& n = nodes_[r];
+        Node& p = nodes_[o.parent];
+        n.parent = o.parent;
+        n.prev = o.prev;
+        n.next = o.next;
+        if(o.prev != NIL) nodes_[o.prev].next = r;
+        else p.first = r;
+        if(o.next != NIL) nodes_[o.next].prev = r;
+        else p.last = r;
+        o.parent = NIL;
+        o.prev = NIL;
+        o.next = NIL;
     }
 private:
-    T data_;
-    Weight weight_; //children's weight is > current weight
-    WTree* parent_;
-    std::vector< WTree* > children_;
+    std::vector< Node > nodes_;
+    Index root_ = NIL;
 };
 
 
@@ -212,23 +348,19 @@ template < typename T,
            typename OFFT = WT >
 class STree {
 public:
-    //copy constructor, copies tree and also makes the tree_ pointer point
-    //to the correct node in the newly created tree
-    STree(const STree& t) : weights_(t.weights_), tree_(nullptr),
-                            offset_(t.offset_) {
-        if(t.tree_) {
-            root_ = TPtr(t.tree_->Root()->DeepCopy(t.tree_, tree_));
-        }
-    }
-    STree(STree&& t) : tree_(t.tree_),
-                       root_(std::move(t.root_)),
-                       weights_(std::move(t.weights_)),
+    using Tree = WTree< T, WT, OFFT>;
+    //node indices are preserved by copy and move, no relinking is needed
+    STree(const STree& t) : weights_(t.weights_), tree_(t.tree_),
+                            current_(t.current_), offset_(t.offset_) {}
+    STree(STree&& t) : weights_(std::move(t.weights_)),
+                       tree_(std::move(t.tree_)),
+                       current_(t.current_),
                        offset_(t.offset_) {}
     STree& operator=(STree s) {
-        weights_ = std::move(s.weights);
-        root_ = std::move(s.root_);
+        weights_ = std::move(s.weights_);
+        tree_ = std::move(s.tree_);
+        current_ = s.current_;
         offset_ = s.offset_;
-        tree_ = s.tree_;
         return *this;
     }
     STree(const WM& wm) : weights_(wm) {}
@@ -238,13 +370,8 @@ public:
         if(ScopeBegin(data)) offset_ += weight;
         else if(ScopeEnd(data)) offset_ -= weight;
         if((ScopeBegin(data) || ScopeEnd(data)) && !scopeAdd) return *this;
-        if(!root_) {
-            tree_ = new WTree< T >(data, weight);
-        } else {
-            tree_ = tree_->Insert(data, weight);
-        }
-        root_.release();
-        root_ = TPtr(tree_->Root());
+        if(tree_.Empty()) current_ = tree_.Add(data, weight);
+        else current_ = tree_.Insert(current_, data, weight);
         return *this;
     }
     STree& Add(const T& data, bool scopeAdd = false) {
@@ -254,27 +381,33 @@ public:
     ///Rewind: no offset is taken into account, use Offset() to add
     ///offset before calling this method as needed
     STree& Rewind(WT weight) {
-        assert(root_);
-        assert(tree_);
+        assert(!tree_.Empty());
         if(marks_.size() > 1) weight += offset_;
-        tree_ = tree_->Rewind(weight);
+        current_ = tree_.Rewind(current_, weight);
         return *this;
     }
     template < typename FunctionMapT >
     typename Result<
         typename FunctionMapT::value_type::second_type >::Type
-    Eval(const FunctionMapT& fm ) {
-        assert(root_);
-        return root_->Eval(fm);
+    Eval(const FunctionMapT& fm ) const {
+        assert(!tree_.Empty());
+        return tree_.Eval(fm);
+    }
+    template < typename FunctionMapT >
+    typename Result<
+        typename FunctionMapT::value_type::second_type >::Type
+    EvalArgs(const FunctionMapT& fm ) const {
+        assert(!tree_.Empty());
+        return tree_.EvalArgs(fm);
     }
     template < typename F >
-    F Apply(F f) {
-        assert(root_);
-        return root_->Apply(f);
+    F Apply(F f) const {
+        assert(!tree_.Empty());
+        return tree_.Apply(f);
     }
     template < typename F >
-    F ScopedApply(F&& f) {
-        return root_->ScopedApply(std::forward< F >(f));
+    F ScopedApply(F&& f) const {
+        return tree_.ScopedApply(std::forward< F >(f));
     }
     void OffsetInc(typename WM::value_type::first_type t) {
         offset_ += weights_[t];
@@ -285,15 +418,16 @@ public:
     void SaveOffset() { marks_.push(offset_); }
     void ResetOffset() { offset_ = marks_.top(); marks_.pop(); }
     void SetWeights(const WM& wm) { weights_ = wm; }
-    void Reset() { root_.reset(nullptr); offset_ = Offset(0); tree_ = nullptr; }
+    ///Clears the tree, node storage is kept and reused by the next parse.
+    void Reset() { tree_.Clear(); offset_ = Offset(0); current_ = Tree::NIL; }
     OFFT GetOffset() const { return offset_; }
+    const Tree& GetTree() const { return tree_; }
 private:
-    using Tree = WTree< T, WT, OFFT>;
-    using TPtr = std::unique_ptr< Tree > ;
+    using Index = typename Tree::Index;
     using Offset = OFFT;
     WM weights_;
-    TPtr root_;
-    Tree* tree_ = nullptr;
+    Tree tree_;
+    Index current_ = Tree::NIL;
     Offset offset_ = Offset(0);
     std::stack< Offset > marks_;
 };
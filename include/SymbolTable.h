@@ -0,0 +1,72 @@
+#pragma once
+//Thread-safe symbol table: names to dense slot indices
+
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace parsley {
+
+///Maps names to dense integer slots assigned in insertion order.
+///Slots are meant to be resolved once at parse time and then used as
+///indices into plain arrays of values or functions during evaluation; the
+///table only stores names, values are owned by the client code, possibly
+///one array per evaluation context sharing the same table.
+///Slots are never invalidated; all the methods can be invoked concurrently
+///from multiple threads.
+///@code
+///SymbolTable symbols;
+///vector< double > values;
+///const size_t x = symbols.Add("x");
+///if(x >= values.size()) values.resize(x + 1);
+///values[x] = 2;
+///@endcode
+class SymbolTable {
+public:
+    using Slot = std::size_t;
+    enum : Slot { NONE = ~Slot(0) };
+    SymbolTable() = default;
+    ///Adds names in order: first name maps to slot zero
+    SymbolTable(std::initializer_list< std::string > names) {
+        for(auto& n: names) Add(n);
+    }
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    ///Returns slot of name, a new slot is assigned if name not found
+    Slot Add(const std::string& name) {
+        std::lock_guard< std::mutex > lock(mutex_);
+        auto i = slots_.find(name);
+        if(i != slots_.end()) return i->second;
+        const Slot s = names_.size();
+        names_.push_back(name);
+        slots_[name] = s;
+        return s;
+    }
+    ///Returns slot of name or @c NONE if name not found
+    Slot Find(const std::string& name) const {
+        std::lock_guard< std::mutex > lock(mutex_);
+        auto i = slots_.find(name);
+        return i == slots_.end() ? Slot(NONE) : i->second;
+    }
+    ///Returns name stored in slot
+    std::string Name(Slot s) const {
+        std::lock_guard< std::mutex > lock(mutex_);
+        assert(s < names_.size());
+        return names_[s];
+    }
+    ///Returns number of slots
+    std::size_t Size() const {
+        std::lock_guard< std::mutex > lock(mutex_);
+        return names_.size();
+    }
+private:
+    std::unordered_map< std::string, Slot > slots_;
+    std::vector< std::string > names_;
+    mutable std::mutex mutex_;
+};
+
+}
@@ -0,0 +1,244 @@
+#pragma once
+////////////////////////////////////////////////////////////////////////////////
+//Parsley - parsing framework
+//Copyright (c) 2010-2015, Ugo Varetto
+//All rights reserved.
+//
+//Redistribution and use in source and binary forms, with or without
+//modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the
+//      names of its contributors may be used to endorse or promote products
+//      derived from this software without specific prior written permission.
+//
+//THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+//AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+//IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+//DISCLAIMED. IN NO EVENT SHALL UGO VARETTO BE LIABLE FOR ANY
+//DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+//(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+//ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+//(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+//SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+////////////////////////////////////////////////////////////////////////////////
+
+/// @file binding.h Parsers storing converted values directly into client
+/// data structures.
+///
+/// A Binding identifies the object currently being filled; parsers created
+/// through the Member and Setter functions write the value returned by
+/// the contained parser's @c GetValue() method into the bound object as soon
+/// as parsing succeeds, without populating any value map:
+/// @code
+/// struct Atom { String name; double x, y, z; };
+/// Binding< Atom > atom;
+/// AndParser record;
+/// record.Add( Member( atom, &Atom::name, AlphaNumParser() ) )
+///       .Add( Member( atom, &Atom::x, FloatParser() ) )
+///       .Add( Member( atom, &Atom::y, FloatParser() ) )
+///       .Add( Member( atom, &Atom::z, FloatParser() ) );
+/// std::vector< Atom > atoms;
+/// MultiParser mp( BoundRecordParser< Atom >( atom, record, atoms ) );
+/// mp.Parse( is );
+/// @endcode
+/// Binding parsers can be freely mixed with parsers returning values through
+/// IParser::GetValues, which remains available for dynamic use.
+
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include "Parser.h"
+#include "parsers.h"
+
+namespace parsley {
+
+//------------------------------------------------------------------------------
+/// @brief Reference to the object parsed values are stored into.
+///
+/// Copies of a Binding refer to the same target: parsers are copied when
+/// added to composite parsers and all the copies must see the object set
+/// through Binding::Bind.
+/// Vector elements are referenced by index, so that the target remains valid
+/// when the vector is resized while parsing, e.g. by nested records appending
+/// to the same vector.
+/// @tparam S type of bound object.
+/// @ingroup BindingParsers
+template < typename S >
+class Binding {
+public:
+    /// Bound object: @c object or element @c index of @c vector.
+    struct State {
+        State( S* o = 0, std::vector< S >* v = 0, std::size_t i = 0 )
+            : object( o ), vector( v ), index( i ) {}
+        S* object;
+        std::vector< S >* vector;
+        std::size_t index;
+    };
+    /// Default constructor: no object bound.
+    Binding() : target_( new State ) {}
+    /// Sets target object.
+    /// @param s object parsed values are written into.
+    void Bind( S& s ) const { *target_ = State( &s ); }
+    /// Sets target vector element.
+    /// @param v vector
+    /// @param i index of element parsed values are written into.
+    void Bind( std::vector< S >& v, std::size_t i ) const {
+        *target_ = State( 0, &v, i );
+    }
+    /// Unbinds target object.
+    void Release() const { *target_ = State(); }
+    /// @return current target, to be restored through Binding::Restore.
+    State Save() const { return *target_; }
+    /// Sets target returned by Binding::Save.
+    void Restore( const State& s ) const { *target_ = s; }
+    /// @return pointer to bound object or @c NULL.
+    S* Target() const {
+        return target_->vector ? &( *target_->vector )[ target_->index ]
+                               : target_->object;
+    }
+private:
+    /// Bound object, shared among copies.
+    std::shared_ptr< State > target_;
+};
+
+//------------------------------------------------------------------------------
+/// @brief Setter assigning a value to a data member.
+/// @ingroup BindingParsers
+template < typename S, typename T >
+struct MemberSetter {
+    MemberSetter( T S::* m ) : member( m ) {}
+    template < typename V >
+    void operator()( S& s, const V& v ) const { s.*member = T( v ); }
+    T S::* member;
+};
+
+//------------------------------------------------------------------------------
+/// @brief Applies a typed parser and passes the converted value to a setter
+/// together with the object referenced by a Binding.
+///
+/// The parser type is required to expose a @c GetValue() method returning
+/// the converted value, e.g. FloatParser. The setter is invoked as
+/// <tt>setter( object, value )</tt>. No values are returned through
+/// BoundParser::GetValues.
+/// @tparam S type of bound object
+/// @tparam ParserT parser type
+/// @tparam SetterT setter type
+/// @ingroup BindingParsers
+template < typename S, typename ParserT, typename SetterT >
+class BoundParser : public IParser {
+public:
+    typedef Values::value_type::second_type ValueType;
+    typedef Values::key_type KeyType;
+    /// Constructor.
+    /// @param b binding
+    /// @param setter setter invoked after each successful parse
+    /// @param p parser
+    BoundParser( const Binding< S >& b, const SetterT& setter,
+                 const ParserT& p = ParserT() )
+        : binding_( b ), setter_( setter ), parser_( p ) {}
+    /// Implementation of IParser::Parse: applies parser and stores the
+    /// value into the bound object, if any.
+    bool Parse( InStream& is ) {
+        if( !parser_.Parse( is ) ) return false;
+        if( S* s = binding_.Target() ) setter_( *s, parser_.GetValue() );
+        return true;
+    }
+    /// Implementation of IParser::GetValues.
+    /// @return empty map
+    const Values& GetValues() const { return valueMap_; }
+    /// Implementation of IParser::operator[]
+    /// @exception std::logic_error always: no values stored.
+    const ValueType& operator[]( const KeyType& ) const {
+        throw std::logic_error( "Cannot find value" );
+    }
+    /// Implementation of IParser::Clone.
+    BoundParser* Clone() const { return new BoundParser( *this ); }
+private:
+    /// Reference to target object.
+    Binding< S > binding_;
+    /// Setter.
+    SetterT setter_;
+    /// Parser.
+    ParserT parser_;
+    /// Empty value map.
+    Values valueMap_;
+};
+
+/// Returns a parser storing the parsed value into a data member of the
+/// bound object.
+/// @ingroup BindingParsers
+template < typename S, typename T, typename ParserT >
+BoundParser< S, ParserT, MemberSetter< S, T > >
+Member( const Binding< S >& b, T S::* m, const ParserT& p ) {
+    return BoundParser< S, ParserT, MemberSetter< S, T > >(
+        b, MemberSetter< S, T >( m ), p );
+}
+
+/// Returns a parser passing the parsed value to a setter callable as
+/// <tt>f( object, value )</tt>.
+/// @ingroup BindingParsers
+template < typename S, typename SetterT, typename ParserT >
+BoundParser< S, ParserT, SetterT >
+Setter( const Binding< S >& b, const SetterT& f, const ParserT& p ) {
+    return BoundParser< S, ParserT, SetterT >( b, f, p );
+}
+
+//------------------------------------------------------------------------------
+/// @brief Appends a new element to a client provided @c std::vector, binds it
+/// and applies a record parser; the element is removed if parsing fails.
+///
+/// Use with MultiParser to fill a vector with one element per record.
+/// The previous target is restored after parsing, so that record parsers can
+/// be nested: after an inner record the outer record's element is bound
+/// again. If parsing fails all the elements appended by the record, including
+/// the ones added by nested records, are removed.
+/// @tparam S element type, must be default constructible.
+/// @ingroup BindingParsers
+template < typename S >
+class BoundRecordParser : public IParser {
+public:
+    typedef Values::value_type::second_type ValueType;
+    typedef Values::key_type KeyType;
+    /// Constructor.
+    /// @param b binding used by the parsers contained in the record parser
+    /// @param p record parser
+    /// @param out vector receiving parsed records
+    BoundRecordParser( const Binding< S >& b, const Parser& p,
+                       std::vector< S >& out )
+        : binding_( b ), parser_( p ), out_( &out ) {}
+    /// Implementation of IParser::Parse.
+    bool Parse( InStream& is ) {
+        const typename Binding< S >::State prev = binding_.Save();
+        const std::size_t size = out_->size();
+        out_->push_back( S() );
+        binding_.Bind( *out_, size );
+        const bool ok = parser_.Parse( is );
+        binding_.Restore( prev );
+        if( !ok ) out_->erase( out_->begin() + size, out_->end() );
+        return ok;
+    }
+    /// Implementation of IParser::GetValues: returns the values of the record
+    /// parser, if any.
+    const Values& GetValues() const { return parser_.GetValues(); }
+    /// Implementation of IParser::operator[]
+    const ValueType& operator[]( const KeyType& k ) const {
+        return parser_[ k ];
+    }
+    /// Implementation of IParser::Clone.
+    BoundRecordParser* Clone() const { return new BoundRecordParser( *this ); }
+private:
+    /// Reference to target object.
+    Binding< S > binding_;
+    /// Record parser.
+    Parser parser_;
+    /// Output vector.
+    std::vector< S >* out_;
+};
+
+} //namespace
@@ -96,6 +96,10 @@
 /// @defgroup StringParsers String Parsers
 /// @ingroup Parsers
 /// Parsers for strings
+
+/// @defgroup BindingParsers Binding Parsers
+/// @ingroup Parsers
+/// Parsers storing converted values directly into client data structures
 //------------------------------------------------------------------------------
 //VALIDATORS used by string parsers
 /// @defgroup validators Text validators
@@ -31,6 +31,12 @@
 #include <map>
 #include <list>
 #include <vector>
+#include <array>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <cassert>
 //#include <locale> in case support for locale-dependent decimal format needed
 
 #include "Parser.h"
@@ -196,9 +202,13 @@ public:
     typedef Values::value_type::second_type ValueType;
     typedef Values::key_type KeyType;
     typedef InStream::char_type Char;
-    UIntParser( const KeyType& name = KeyType() ) : name_( name ) {}
+    /// Type of converted value.
+    typedef unsigned DataType;
+    UIntParser( const KeyType& name = KeyType() ) 
+        : name_( name ), validateOnly_( false ) {}
     UIntParser( const UIntParser& p ) 
-        : name_( p.name_ ), token_( p.token_ ), valueMap_( p.valueMap_ ) {}
+        : name_( p.name_ ), token_( p.token_ ), valueMap_( p.valueMap_ ),
+          validateOnly_( p.validateOnly_ ) {}
     /// Parses che characters composing an unsigned integer value. 
     /// The characters are stored inside a member variable for further 
     /// conversion to <tt>unsigned int</tt>.
@@ -213,7 +223,7 @@ public:
             is.unget();
             return false;
         }
-        token_.push_back( c );
+        if( !validateOnly_ ) token_.push_back( c );
         GetNumber( is );
         return true;
     }
@@ -244,15 +254,27 @@ public:
     /// @return textual representation of parsed number.
     const String& GetText() const { return token_; }
 
+    /// Converts parsed text without going through the value map.
+    /// @return parsed value.
+    DataType GetValue() const {
+        return DataType( parsley::ToInt( token_.c_str() ) );
+    }
+
     UIntParser* Clone() const { return new UIntParser( *this ); }
 
+    /// Implementation of IParser::Project: if value not required digits are
+    /// validated but not stored.
+    void Project( const ValueIDs& ids ) {
+        validateOnly_ = ids.find( name_ ) == ids.end();
+    }
+
 private:
     void GetNumber( InStream& is ) {
         if( !is.good() ) return;
         Char c = is.get();
         if( !is.good() ) return;
         while( is.good() && parsley::IsDigit( c ) != 0 ) {
-            token_.push_back( c );
+            if( !validateOnly_ ) token_.push_back( c );
             c = is.get();
         }
         if( is.good() ) is.unget();
@@ -266,6 +288,8 @@ private:
     /// number is converted and stored into map only when UIntParser::GetValues
     /// called.
     mutable Values valueMap_;
+    /// If @c true parsed text is not stored.
+    bool validateOnly_;
 };
 
 
@@ -279,9 +303,13 @@ public:
     typedef Values::value_type::second_type ValueType;
     typedef Values::key_type KeyType;
     typedef InStream::char_type Char;
-    IntParser( const KeyType& name = KeyType() ) : name_( name ) {}
+    /// Type of converted value.
+    typedef int DataType;
+    IntParser( const KeyType& name = KeyType() ) 
+        : name_( name ), validateOnly_( false ) {}
     IntParser( const IntParser& p ) 
-        : name_( p.name_ ), token_( p.token_ ), valueMap_( p.valueMap_ ) {}
+        : name_( p.name_ ), token_( p.token_ ), valueMap_( p.valueMap_ ),
+          validateOnly_( p.validateOnly_ ) {}
     /// Parses che characters composing an  integer value. The characters are 
     /// stored inside an member variable for further conversion to <tt>int</tt>.
     /// @return @c true if integer parsed; @c false otherwise.  
@@ -293,15 +321,16 @@ public:
         REWIND r( ok, is );
         Char c = is.get();
         if( !is.good() ) return false;
+        UIntParser uil;
+        if( validateOnly_ ) uil.Project( ValueIDs() );
         if( c == '+' || c == '-' ) {
-            UIntParser uil;
-            if( uil.Parse( is ) ) { token_ = c + uil.GetText(); ok = true; }
-            else return false;          
+            if( !uil.Parse( is ) ) return false;
+            if( !validateOnly_ ) token_ = c + uil.GetText();
         }
         else {
-            UIntParser uil;
-            if( uil.Parse( is ) ) { token_ = uil.GetText(); ok = true; }
-            else return false;
+            is.unget();
+            if( !uil.Parse( is ) ) return false;
+            token_ = uil.GetText();
         }
         ok = true;
         }
@@ -332,8 +361,23 @@ public:
         return i->second;
     }
 
+    /// @return textual representation of parsed number.
+    const String& GetText() const { return token_; }
+
+    /// Converts parsed text without going through the value map.
+    /// @return parsed value.
+    DataType GetValue() const {
+        return DataType( parsley::ToInt( token_.c_str() ) );
+    }
+
     IntParser* Clone() const { return new IntParser( *this ); } 
 
+    /// Implementation of IParser::Project: if value not required digits are
+    /// validated but not stored.
+    void Project( const ValueIDs& ids ) {
+        validateOnly_ = ids.find( name_ ) == ids.end();
+    }
+
 private:
     /// Name of parsed value in value map.
     KeyType name_;
@@ -343,6 +387,8 @@ private:
     /// number is converted and stored into map only when IntParser::GetValues
     /// called.
     mutable Values valueMap_;
+    /// If @c true parsed text is not stored.
+    bool validateOnly_;
 };
 
 
@@ -362,15 +408,20 @@ class FloatParser : public IParser {
 public:
     typedef Values::value_type::second_type ValueType;
     typedef Values::key_type KeyType;
+    /// Type of converted value.
+    typedef double DataType;
     FloatParser( const FloatParser& p ) 
-        : name_( p.name_ ), valueMap_( p.valueMap_ ) {}
-    FloatParser( const KeyType& name = KeyType() ) : name_( name ) {} 
+        : name_( p.name_ ), valueMap_( p.valueMap_ ), length_( 0 ),
+          validateOnly_( p.validateOnly_ ) {}
+    FloatParser( const KeyType& name = KeyType() ) 
+        : name_( name ), length_( 0 ), validateOnly_( false ) {} 
     virtual const String& GetText() const { return token_ ; }
     /// Reads a floating point number and stores the sequence of parsed 
     /// characters into a member variable. No conversion to a float number is 
     /// performed during parsing.
     virtual bool Parse( InStream& is ) {
         token_.clear();
+        length_ = 0;
         valueMap_.clear();
         if( !is.good() ) return false;
         // in case support for locale-dependent decimal separator is needed:
@@ -382,21 +433,19 @@ public:
         const Char c = is.get();
         if( !is.good() ) return false;  
         if( c == '+' || c == '-' ) {
-            if( Apply( &FloatParser::MatchUnsigned, is, c ) ) {
-                token_ = c + token_;
-            }
+            Push( c );
+            if( !Apply( &FloatParser::MatchUnsigned, is, c ) ) Truncate( 0 );
         }
         else if( c == '.' ) {
-            if( Apply( &FloatParser::MatchFractional, is, c ) ) {
-                token_ = c + token_;
-            }
+            Push( c );
+            if( !Apply( &FloatParser::MatchFractional, is, c ) ) Truncate( 0 );
         }
         else if( parsley::IsDigit( c ) != 0 ) {
             is.unget();
             Apply( &FloatParser::MatchUnsigned, is, 0 );
         }
         else return false;
-        ok = token_.length() > 0;
+        ok = length_ > 0;
         }
         return ok;
     }
@@ -422,25 +471,47 @@ public:
         return i->second;
     }
 
+    /// Converts parsed text without going through the value map.
+    /// @return parsed value.
+    DataType GetValue() const { return parsley::ToFloat( token_.c_str() ); }
+
     virtual FloatParser* Clone() const {
         return new FloatParser( *this );
     }
 
+    /// Implementation of IParser::Project: if value not required the number
+    /// is validated but not stored.
+    void Project( const ValueIDs& ids ) {
+        validateOnly_ = ids.find( name_ ) == ids.end();
+    }
+
 
 private:
     typedef bool( FloatParser::*MatchMethod )( InStream& ); 
 
+    /// Appends character to parsed text.
+    void Push( Char c ) {
+        if( !validateOnly_ ) token_.push_back( c );
+        ++length_;
+    }
+    /// Restores parsed text to a previous length.
+    void Truncate( String::size_type length ) {
+        if( !validateOnly_ ) token_.resize( length );
+        length_ = length;
+    }
+
     bool Apply( MatchMethod f, InStream& is, Char last ) {
         if( !is.good() ) return false;
-        const String tmp = token_; // save current value
-        const StreamPos pos = is.tellg();
+        const String::size_type length = length_; // save current length
+        const InStream::Mark mark = is.mark();
         const bool m = (this->*f)( is );
         if( !m ) {
             //restore previous value
-            token_ = tmp;
+            Truncate( length );
             //restore stream pointer
-            is.seekg( pos );
+            is.reset( mark );
         }
+        is.release( mark );
         //last == 0 is a signal that enough input has been validated to make
         //the token a valid float 
         return last == 0 || m;
@@ -451,12 +522,12 @@ private:
         const Char c = is.get();
         if( !is.good() ) return false;
         if( parsley::IsDigit( c ) != 0 ) { 
-            token_.push_back( c ); 
+            Push( c ); 
             Apply( &FloatParser::MatchUnsigned, is, 0 ); 
             return true; 
         }
         else if( c == '.' ) { 
-            token_.push_back( c ); 
+            Push( c ); 
             return Apply( &FloatParser::MatchFractional, is, c ); 
         }
         is.unget();
@@ -468,7 +539,7 @@ private:
         const Char c = is.get();
         if( !is.good() ) return false;
         if( parsley::IsDigit( c ) ) {
-            token_.push_back( c ); 
+            Push( c ); 
             Apply( &FloatParser::MatchFractional, is, 0 );
             return true;
         }
@@ -477,7 +548,7 @@ private:
              // (as of 2009) problem: on windows 'D' (with both vc++ and migw) 
              // is properly understood but not on linux/mac: need to force a 
              // 'D' -> 'E' translation
-             token_.push_back( 'E' );
+             Push( 'E' );
              return Apply( &FloatParser::MatchExponent, is, c );
         }
         is.unget();
@@ -488,11 +559,11 @@ private:
         const Char c = is.get();
         if( !is.good() ) return false;
         if( c == '+' || c == '-' ) {
-            token_.push_back( c ); 
+            Push( c ); 
             return Apply( &FloatParser::MatchExponent, is, c );
         }
         else if( parsley::IsDigit( c ) ) {
-            token_.push_back( c ); 
+            Push( c ); 
             Apply( &FloatParser::MatchExponent, is,  0 ); 
             return true;
         }
@@ -508,6 +579,10 @@ private:
     /// number is converted and stored into map only when FloatParser::GetValues
     /// called.
     mutable Values valueMap_;
+    /// Number of parsed characters.
+    String::size_type length_;
+    /// If @c true parsed text is not stored.
+    bool validateOnly_;
 };
 
 //------------------------------------------------------------------------------
@@ -544,7 +619,143 @@ struct FirstAlphaNumValidator {
     void Reset() {}
 };
 
-/// @brief Validates a constant string with support for case-insensitive 
+//------------------------------------------------------------------------------
+/// @brief Set of characters stored as a 256 bit mask.
+///
+/// All the operations are @c constexpr so that character classes can be built
+/// at compile time from ranges and sets of characters and combined through
+/// union, intersection and negation:
+/// @code
+/// constexpr CharClass HEX = CharClass::Range( '0', '9' )
+///                           | CharClass::Range( 'a', 'f' )
+///                           | CharClass::Range( 'A', 'F' );
+/// constexpr CharClass NOT_BLANK = ~CharClass::Set( " \t\r\n" );
+/// @endcode
+/// Membership tests do not depend on the current locale.
+/// @ingroup validators
+class CharClass {
+public:
+    typedef unsigned long long Word;
+    /// Default constructor: empty set.
+    constexpr CharClass() : w0_( 0 ), w1_( 0 ), w2_( 0 ), w3_( 0 ) {}
+    /// Constructor from mask words, @c w0 holds bits for characters [0, 63].
+    constexpr CharClass( Word w0, Word w1, Word w2, Word w3 )
+        : w0_( w0 ), w1_( w1 ), w2_( w2 ), w3_( w3 ) {}
+    /// Returns the set of characters in range <tt>[lo, hi]</tt>.
+    static constexpr CharClass Range( unsigned char lo, unsigned char hi ) {
+        return CharClass( RangeWord( lo, hi, 0 ), RangeWord( lo, hi, 64 ),
+                          RangeWord( lo, hi, 128 ), RangeWord( lo, hi, 192 ) );
+    }
+    /// Returns the set of characters contained in a null terminated string.
+    static constexpr CharClass Set( const char* s ) {
+        return *s == 0 ? CharClass()
+                       : Range( (unsigned char)( *s ), (unsigned char)( *s ) )
+                         | Set( s + 1 );
+    }
+    /// Returns @c true if character is in set.
+    constexpr bool Test( Char c ) const {
+        return ( ( GetWord( (unsigned char)( c ) >> 6 )
+                   >> ( (unsigned char)( c ) & 63 ) ) & 1 ) != 0;
+    }
+    /// Union.
+    constexpr CharClass operator|( const CharClass& c ) const {
+        return CharClass( w0_ | c.w0_, w1_ | c.w1_, w2_ | c.w2_, w3_ | c.w3_ );
+    }
+    /// Intersection.
+    constexpr CharClass operator&( const CharClass& c ) const {
+        return CharClass( w0_ & c.w0_, w1_ & c.w1_, w2_ & c.w2_, w3_ & c.w3_ );
+    }
+    /// Complement.
+    constexpr CharClass operator~() const {
+        return CharClass( ~w0_, ~w1_, ~w2_, ~w3_ );
+    }
+private:
+    constexpr Word GetWord( unsigned i ) const {
+        return i == 0 ? w0_ : i == 1 ? w1_ : i == 2 ? w2_ : w3_;
+    }
+    /// Bits [lo, hi] in a 64 bit word.
+    static constexpr Word Bits( unsigned lo, unsigned hi ) {
+        return ( hi == 63 ? ~Word( 0 ) : ( Word( 1 ) << ( hi + 1 ) ) - 1 )
+               & ~( ( Word( 1 ) << lo ) - 1 );
+    }
+    /// Bits for characters in range [lo, hi] falling into the word covering
+    /// characters [base, base + 63].
+    static constexpr Word RangeWord( unsigned lo, unsigned hi, unsigned base ) {
+        return hi < base || lo > base + 63 || lo > hi ? Word( 0 )
+               : Bits( ( lo > base ? lo : base ) - base,
+                       ( hi < base + 63 ? hi : base + 63 ) - base );
+    }
+    Word w0_;
+    Word w1_;
+    Word w2_;
+    Word w3_;
+};
+
+/// @brief Decimal digits.
+/// @ingroup validators
+struct DigitChars {
+    static constexpr CharClass Value() { return CharClass::Range( '0', '9' ); }
+};
+
+/// @brief ASCII letters.
+/// @ingroup validators
+struct AlphaChars {
+    static constexpr CharClass Value() {
+        return CharClass::Range( 'a', 'z' ) | CharClass::Range( 'A', 'Z' );
+    }
+};
+
+/// @brief ASCII letters and decimal digits.
+/// @ingroup validators
+struct AlnumChars {
+    static constexpr CharClass Value() {
+        return AlphaChars::Value() | DigitChars::Value();
+    }
+};
+
+/// @brief Blank characters.
+/// @ingroup validators
+struct SpaceChars {
+    static constexpr CharClass Value() {
+        return CharClass::Set( " \t\n\v\f\r" );
+    }
+};
+
+/// @brief Validator built from character classes.
+///
+/// The first character is validated against the @c FirstT class, all the
+/// following characters against the @c RestT class; no other information is
+/// read from the already validated text.
+/// Classes are types exposing a <tt>static constexpr CharClass Value()</tt>
+/// method:
+/// @code
+/// struct IdChars {
+///     static constexpr CharClass Value() {
+///         return AlnumChars::Value() | CharClass::Set( "_" );
+///     }
+/// };
+/// typedef SequenceParser< CharClassValidator< AlphaChars, IdChars > >
+///         IdentifierParser;
+/// @endcode
+/// @ingroup validators
+template < class FirstT, class RestT = FirstT >
+struct CharClassValidator {
+    /// Validates character against first or next character class.
+    bool Validate( const String& s, Char newChar ) const {
+        return s.empty() ? FirstT::Value().Test( newChar )
+                         : RestT::Value().Test( newChar );
+    }
+    void Reset() {}
+};
+
+/// @brief Bitmap based alphanumeric validator.
+/// @ingroup validators
+typedef CharClassValidator< AlnumChars > AlnumClassValidator;
+/// @brief Bitmap based validator for identifiers starting with a letter.
+/// @ingroup validators
+typedef CharClassValidator< AlphaChars, AlnumChars > IdentifierValidator;
+
+/// @brief Validates a constant string with support for case-insensitive
 /// validation.
 /// @ingroup validators
 /// @todo use stream's facilities to perform uppercase \<-\> lowercase 
@@ -581,6 +792,10 @@ public:
     }
     /// Resets internal character index.
     void Reset() { count_ = 0; }
+    /// Returns constant string.
+    const String& GetString() const { return value_; }
+    /// Returns @c true if comparison is case-insensitive.
+    bool IgnoreCase() const { return ignoreCase_; }
 private:
     /// Constant string value.
     String value_;
@@ -663,6 +878,15 @@ public:
     SequenceParser* Clone() const { return new SequenceParser( *this ); }   
     /// @return last parsed text
     const String& GetText() const { return token_; }
+    /// Type of parsed value.
+    typedef String DataType;
+    /// @return last parsed text; same as SequenceParser::GetText, used by
+    /// typed parsers e.g. BoundParser.
+    const DataType& GetValue() const { return token_; }
+    /// @return name associated to parsed value.
+    const ValueID& GetName() const { return name_; }
+    /// @return validator.
+    const Validator& GetValidator() const { return validator_; }
 private:
     /// Name associated to retrieved value(s); set as key in value map 
     ValueID name_;
@@ -689,6 +913,14 @@ public:
     const Values& GetValues() const { return csv_.GetValues(); }
     const ValueType& operator[]( const KeyType& k ) const { return csv_[ k ]; }
     ConstStringParser* Clone() const { return new ConstStringParser( *this ); } 
+    /// @return constant string.
+    const String& GetString() const { 
+        return csv_.GetValidator().GetString();
+    }
+    /// @return @c true if comparison is case-insensitive.
+    bool IgnoreCase() const { return csv_.GetValidator().IgnoreCase(); }
+    /// @return name associated to parsed value.
+    const ValueID& GetName() const { return csv_.GetName(); }
 private:
     SequenceParser< ConstStringValidator > csv_;
 };
@@ -706,6 +938,10 @@ public:
     const Values& GetValues() const { return anl_.GetValues(); }
     const ValueType& operator[]( const KeyType& k ) const { return anl_[ k ]; }
     AlphaNumParser* Clone() const { return new AlphaNumParser( *this ); }
+    /// Type of parsed value.
+    typedef String DataType;
+    /// @return last parsed text.
+    const DataType& GetValue() const { return anl_.GetValue(); }
 private:
     SequenceParser< AlphaNumValidator > anl_;
 };
@@ -759,6 +995,12 @@ public:
     FirstAlphaNumParser* Clone() const { 
         return new FirstAlphaNumParser( *this ); 
     } 
+    /// Type of parsed value.
+    typedef String DataType;
+    /// @return last parsed text.
+    const DataType& GetValue() const { return token_; }
+    /// @return name assigned to parsed value.
+    const String& GetName() const { return name_; }
 private:
     String name_;
     String token_;
@@ -777,7 +1019,7 @@ public:
     typedef Values::key_type KeyType;
     typedef InStream::char_type Char;
     typedef std::list< Parser > Parsers;
-    TupleParser() {}
+    TupleParser() : collect_( true ) {}
     /// Constructor.
     /// @param v value parser: used to parse individual tuple values
     /// @param name name assigned to parsed value array in returned value map
@@ -793,15 +1035,22 @@ public:
                  const Parser& e = BlankParser(), bool blanks = false ) 
                  : skipBlanks_( blanks ),
                  beginParser_( b ), valueParser_( v ), 
-                 separatorParser_( s ), endParser_( e ), name_( name ) {}
+                 separatorParser_( s ), endParser_( e ), name_( name ),
+                 collect_( true ) {}
     TupleParser( const TupleParser& l ) 
         : skipBlanks_( l.skipBlanks_ ), name_( l.name_ ), 
           beginParser_( l.beginParser_ ), 
           valueParser_( l.valueParser_ ), 
           separatorParser_( l.separatorParser_ ),
           endParser_( l.endParser_ ), values_( l.values_ ), 
-          valueMap_( l.valueMap_ )
+          valueMap_( l.valueMap_ ), sink_( l.sink_ ), collect_( l.collect_ )
     {}
+    /// Sets sink receiving the values of each tuple element as soon as it is
+    /// parsed; when a sink is set values are not stored. If the sink returns
+    /// @c false parsing of the tuple fails.
+    /// @param s sink, pass an empty function to restore the default behavior.
+    /// @return reference to @c *this.
+    TupleParser& SetSink( const ValueSink& s ) { sink_ = s; return *this; }
     /// IParser::Parse implementation: applies begin parser, loops over 
     /// values/separators then
     /// applies end parser. Note that it will always parse as many values as 
@@ -824,8 +1073,10 @@ public:
         // start applying value parser
         if( skipBlanks_ ) SkipBlanks( is );
         while( valueParser_.Parse( is ) ) {
-            // parsed values: add values to value array
-            AddValue( valueParser_.GetValues() );
+            // parsed values: add values to value array or forward to sink
+            if( sink_ ) {
+                if( !sink_( valueParser_.GetValues() ) ) return false;
+            } else if( collect_ ) AddValue( valueParser_.GetValues() );
             // increment value counter
             ++counter;
             // apply separator parser and exit loop if it fails
@@ -866,6 +1117,16 @@ public:
     }
     /// IParser::Clone implementation.
     TupleParser* Clone() const { return new TupleParser( *this ); } 
+    /// IParser::Project implementation: same behavior as MultiParser::Project;
+    /// values of begin, separator and end parsers are never used.
+    void Project( const ValueIDs& ids ) {
+        beginParser_.Project( ValueIDs() );
+        separatorParser_.Project( ValueIDs() );
+        endParser_.Project( ValueIDs() );
+        if( ids.find( name_ ) != ids.end() ) return;
+        collect_ = false;
+        valueParser_.Project( ids );
+    }
 
 private:
     /// Advances to first non-blank character or @c EOF.
@@ -902,8 +1163,689 @@ private:
     std::vector< ValueType > values_;
     /// Value map.
     mutable Values valueMap_;
+    /// Optional sink receiving values in place of TupleParser#values_.
+    ValueSink sink_;
+    /// If @c false values are not stored, see TupleParser::Project.
+    bool collect_;
 };
 
+//------------------------------------------------------------------------------
+/// @brief Fixed size tuple parser storing converted values into an
+/// @c std::array.
+///
+/// Same grammar as TupleParser\<SIZE\> but the element parser type is known at
+/// compile time and is required to expose a @c DataType type and a
+/// @c GetValue() method returning the converted value, e.g. FloatParser.
+/// The value/separator sequence is unrolled at compile time and the parsed
+/// values are accessible through StaticTupleParser::GetValue without going
+/// through the value map:
+/// @code
+/// std::istringstream iss( "( 1.0, 2.0, 3.0 )" );
+/// InStream is( iss );
+/// StaticTupleParser< FloatParser, 3 > xyz( FloatParser(), "xyz",
+///     ConstStringParser( "(" ), ConstStringParser( "," ),
+///     ConstStringParser( ")" ), true );
+/// assert( xyz.Parse( is ) );
+/// const std::array< double, 3 >& p = xyz.GetValue();
+/// @endcode
+/// @ingroup Parsers
+template < class ParserT, int SIZE >
+class StaticTupleParser : public IParser {
+public:
+    typedef Values::value_type::second_type ValueType;
+    typedef Values::key_type KeyType;
+    typedef InStream::char_type Char;
+    /// Type of tuple element.
+    typedef typename ParserT::DataType ElementType;
+    /// Type of converted value.
+    typedef std::array< ElementType, SIZE > DataType;
+    /// Constructor.
+    /// @param v value parser: used to parse individual tuple values
+    /// @param name name assigned to parsed value array in returned value map
+    /// @param b begin parser
+    /// @param s separator parser
+    /// @param e end parser
+    /// @param blanks skip blanks flag: if @c true blanks are skipped before
+    /// applying each parser
+    StaticTupleParser( const ParserT& v = ParserT(),
+                       const ValueID& name = ValueID(),
+                       const Parser& b = BlankParser(),
+                       const Parser& s = BlankParser(),
+                       const Parser& e = BlankParser(), bool blanks = false )
+        : skipBlanks_( blanks ), name_( name ), beginParser_( b ),
+          valueParser_( v ), separatorParser_( s ), endParser_( e ) {}
+    /// IParser::Parse implementation. A stream checkpoint is recorded once
+    /// and restored only if parsing fails.
+    bool Parse( InStream& is ) {
+        valueMap_.clear();
+        if( !is.good() ) return false;
+        bool ok = false; {
+        REWIND r( ok, is );
+        ok = ParseTuple( is );
+        }
+        return ok;
+    }
+    /// @return size of tuple.
+    static int Size() { return SIZE; }
+    /// @return parsed values.
+    const DataType& GetValue() const { return data_; }
+    /// IParser::GetValues implementation: returns the parsed values as an
+    /// @c std::vector<Any> to match the TupleParser interface.
+    const Values& GetValues() const {
+        if( valueMap_.empty() ) {
+            valueMap_.insert( std::make_pair( name_,
+                std::vector< ValueType >( data_.begin(), data_.end() ) ) );
+        }
+        return valueMap_;
+    }
+    /// IParser::operator[] implementation
+    const ValueType& operator[]( const KeyType& k ) const {
+        const Values& v = GetValues();
+        Values::const_iterator i = v.find( k );
+        if( i == v.end() ) throw std::logic_error( "Cannot find value" );
+        return i->second;
+    }
+    /// IParser::Clone implementation.
+    StaticTupleParser* Clone() const { return new StaticTupleParser( *this ); }
+
+private:
+    typedef std::integral_constant< int, SIZE > End;
+    /// Applies begin parser, values, separators and end parser.
+    bool ParseTuple( InStream& is ) {
+        if( skipBlanks_ ) SkipBlanks( is );
+        if( !beginParser_.Parse( is ) ) return false;
+        if( skipBlanks_ ) SkipBlanks( is );
+        if( !ParseElements( is, std::integral_constant< int, 0 >() ) ) {
+            return false;
+        }
+        if( skipBlanks_ ) SkipBlanks( is );
+        return endParser_.Parse( is );
+    }
+    /// Parses element I and the following separator.
+    template < int I >
+    bool ParseElements( InStream& is, std::integral_constant< int, I > ) {
+        if( !valueParser_.Parse( is ) ) return false;
+        data_[ I ] = valueParser_.GetValue();
+        if( !separatorParser_.Parse( is ) ) return I == SIZE - 1;
+        if( skipBlanks_ ) SkipBlanks( is );
+        return ParseElements( is, std::integral_constant< int, I + 1 >() );
+    }
+    /// All the elements parsed and last separator found: fail if one more
+    /// value is available, as TupleParser does.
+    bool ParseElements( InStream& is, End ) {
+        return !valueParser_.Parse( is );
+    }
+    /// Advances to first non-blank character or @c EOF.
+    void SkipBlanks( InStream& is ) {
+        if( is.good() ) {
+            Char c = is.get();
+            while( is.good() && parsley::IsSpace( c ) != 0  ) c = is.get();
+            if( is.good() ) is.unget();
+        }
+    }
+    /// Skip blanks flag.
+    bool skipBlanks_;
+    /// Name assigned to values in value map.
+    String name_;
+    /// Parser that identifies the start of the tuple.
+    Parser beginParser_;
+    /// Parser that parses individual tuple components.
+    ParserT valueParser_;
+    /// Parser that parses the expression separating two adjacent values.
+    Parser separatorParser_;
+    /// Parser that parses the expression identifying the end of the tuple.
+    Parser endParser_;
+    /// Parsed values.
+    DataType data_;
+    /// Value map, populated only when StaticTupleParser::GetValues invoked.
+    mutable Values valueMap_;
+};
+
+//------------------------------------------------------------------------------
+/// @brief Contiguous storage for values parsed by RepeatParser.
+///
+/// Scalar values are stored into a single @c std::vector.
+/// @ingroup Parsers
+template < typename T >
+struct RepeatStorage {
+    typedef std::vector< T > Type;
+    typedef T Scalar;
+    static void Append( Type& s, const T& v ) { s.push_back( v ); }
+    static void Reserve( Type& s, std::size_t n ) { s.reserve( n ); }
+    static void Resize( Type& s, std::size_t n ) { s.resize( n ); }
+    static std::size_t Size( const Type& s ) { return s.size(); }
+    static const T& Element( const Type& s, std::size_t i ) { return s[ i ]; }
+    static const T* Data( const Type& s, std::size_t ) { return s.data(); }
+};
+
+/// @brief Storage for fixed size tuples: one @c std::vector per tuple
+/// element (structure of arrays).
+/// @ingroup Parsers
+template < typename T, std::size_t N >
+struct RepeatStorage< std::array< T, N > > {
+    typedef std::array< std::vector< T >, N > Type;
+    typedef T Scalar;
+    static void Append( Type& s, const std::array< T, N >& v ) {
+        for( std::size_t i = 0; i != N; ++i ) s[ i ].push_back( v[ i ] );
+    }
+    static void Reserve( Type& s, std::size_t n ) {
+        for( std::size_t i = 0; i != N; ++i ) s[ i ].reserve( n );
+    }
+    static void Resize( Type& s, std::size_t n ) {
+        for( std::size_t i = 0; i != N; ++i ) s[ i ].resize( n );
+    }
+    static std::size_t Size( const Type& s ) { return s[ 0 ].size(); }
+    static std::array< T, N > Element( const Type& s, std::size_t i ) {
+        std::array< T, N > e;
+        for( std::size_t j = 0; j != N; ++j ) e[ j ] = s[ j ][ i ];
+        return e;
+    }
+    static const T* Data( const Type& s, std::size_t column ) {
+        assert( column < N );
+        return s[ column ].data();
+    }
+};
+
+//------------------------------------------------------------------------------
+/// @brief Applies a typed parser a number of times storing the converted
+/// values into contiguous storage.
+///
+/// Same repetition semantics as MultiParser, but instead of collecting
+/// values into a list of Any objects each value is appended to an
+/// @c std::vector of @c ParserT::DataType, or to one vector per element when
+/// @c ParserT parses fixed size tuples (e.g. StaticTupleParser).
+/// Storage is either owned by the parser and cleared at each invocation of
+/// RepeatParser::Parse, or provided by the client code through
+/// RepeatParser::SetStorage in which case values are appended to it.
+/// @code
+/// RepeatParser< FloatParser > coeffs;
+/// coeffs.Reserve( 100000 );
+/// if( coeffs.Parse( is ) ) {
+///     const double* c = coeffs.Data();
+///     for( std::size_t i = 0; i != coeffs.Size(); ++i ) ...
+/// }
+/// @endcode
+/// @ingroup Parsers
+template < class ParserT >
+class RepeatParser : public IParser {
+public:
+    typedef Values::value_type::second_type ValueType;
+    typedef Values::key_type KeyType;
+    typedef InStream::char_type Char;
+    /// Type of converted value.
+    typedef typename ParserT::DataType ElementType;
+    typedef RepeatStorage< ElementType > StorageTraits;
+    /// Storage type.
+    typedef typename StorageTraits::Type Storage;
+    /// Sink type: receives each converted value, returns @c false to stop.
+    typedef std::function< bool ( const ElementType& ) > Sink;
+    /// Constructor.
+    /// @param p parser to execute.
+    /// @param name value identifier used in the value map
+    /// @param countMin minimum amount of times the parser is invoked
+    /// @param countMax maximum amount of times the parser is invoked.
+    ///        If a number < 0 is specified the parser is invoked until it
+    ///        fails.
+    /// @param blanks skip blanks before each element
+    RepeatParser( const ParserT& p = ParserT(),
+                  const ValueID& name = ValueID(),
+                  int countMin = 1, int countMax = -1, bool blanks = true )
+        : parser_( p ), name_( name ), countMin_( countMin ),
+          countMax_( countMax ), skipBlanks_( blanks ), count_( 0 ),
+          storage_( &owned_ ) {}
+    /// Copy constructor: storage provided by client code is shared with the
+    /// copy.
+    RepeatParser( const RepeatParser& r )
+        : parser_( r.parser_ ), name_( r.name_ ), countMin_( r.countMin_ ),
+          countMax_( r.countMax_ ), skipBlanks_( r.skipBlanks_ ),
+          count_( r.count_ ), owned_( r.owned_ ),
+          storage_( r.storage_ == &r.owned_ ? &owned_ : r.storage_ ),
+          sink_( r.sink_ ) {}
+    /// Move constructor: storage provided by client code is shared with the
+    /// new instance.
+    RepeatParser( RepeatParser&& r )
+        : parser_( std::move( r.parser_ ) ), name_( std::move( r.name_ ) ),
+          countMin_( r.countMin_ ), countMax_( r.countMax_ ),
+          skipBlanks_( r.skipBlanks_ ), count_( r.count_ ),
+          owned_( std::move( r.owned_ ) ),
+          storage_( r.storage_ == &r.owned_ ? &owned_ : r.storage_ ),
+          sink_( std::move( r.sink_ ) ) {
+        r.count_ = 0;
+    }
+    /// Assignment: same storage semantics as copy and move constructors.
+    RepeatParser& operator=( RepeatParser r ) {
+        parser_ = std::move( r.parser_ );
+        name_ = std::move( r.name_ );
+        countMin_ = r.countMin_;
+        countMax_ = r.countMax_;
+        skipBlanks_ = r.skipBlanks_;
+        count_ = r.count_;
+        owned_ = std::move( r.owned_ );
+        storage_ = r.storage_ == &r.owned_ ? &owned_ : r.storage_;
+        sink_ = std::move( r.sink_ );
+        valueMap_.clear();
+        return *this;
+    }
+    /// Sets client provided storage; values are appended to it.
+    RepeatParser& SetStorage( Storage& s ) { storage_ = &s; return *this; }
+    /// Sets sink receiving each converted value in place of the storage;
+    /// if the sink returns @c false the repetition stops.
+    /// @param s sink, pass an empty function to restore the default behavior.
+    RepeatParser& SetSink( const Sink& s ) { sink_ = s; return *this; }
+    /// Capacity hint: reserves space for @c n values.
+    RepeatParser& Reserve( std::size_t n ) {
+        StorageTraits::Reserve( *storage_, StorageTraits::Size( *storage_ )
+                                           + n );
+        return *this;
+    }
+    /// Implementation of IParser::Parse. Invokes the contained parser at
+    /// least RepeatParser#countMin_ times and no more than
+    /// RepeatParser#countMax_ times, or until it fails if
+    /// RepeatParser#countMax_ < 0. In case of failure the stream is rewound
+    /// and the storage is restored to its size before the invocation.
+    bool Parse( InStream& is ) {
+        valueMap_.clear();
+        if( storage_ == &owned_ ) StorageTraits::Resize( owned_, 0 );
+        const std::size_t start = StorageTraits::Size( *storage_ );
+        count_ = 0;
+        if( !is.good() ) return countMin_ <= 0;
+        bool ok = false; {
+        REWIND r( ok, is );
+        while( is.good() && ( count_ < countMax_ || countMax_ < 0 ) ) {
+            if( skipBlanks_ ) SkipBlanks( is );
+            if( !parser_.Parse( is ) ) break;
+            ++count_;
+            if( !sink_ ) StorageTraits::Append( *storage_, parser_.GetValue() );
+            else if( !sink_( parser_.GetValue() ) ) break;
+        }
+        ok = count_ >= countMin_ && !is.cut_failed();
+        }
+        if( !ok ) {
+            StorageTraits::Resize( *storage_, start );
+            count_ = 0;
+        }
+        return ok;
+    }
+    /// Convenience operator to set the minimum and maximum amount of times the
+    /// parser should be invoked.
+    RepeatParser& operator()( int minCount, int maxCount = -1 ) {
+        countMin_ = minCount; countMax_ = maxCount; return *this;
+    }
+    /// @return storage: all the parsed values, including the ones previously
+    /// stored in client provided storage.
+    const Storage& GetData() const { return *storage_; }
+    /// @return pointer to first element of storage; for tuples pointer to
+    /// first element of @c column.
+    const typename StorageTraits::Scalar* Data( std::size_t column = 0 ) const {
+        return StorageTraits::Data( *storage_, column );
+    }
+    /// @return number of values in storage.
+    std::size_t Size() const { return StorageTraits::Size( *storage_ ); }
+    /// @return number of values parsed by last invocation of Parse.
+    int Count() const { return count_; }
+    /// Implementation of IParser::GetValues: returns the values parsed by the
+    /// last invocation of Parse as an @c std::vector<Any>; empty if a sink
+    /// is set.
+    const Values& GetValues() const {
+        if( valueMap_.empty() && count_ > 0 && !sink_ ) {
+            std::vector< ValueType > v;
+            v.reserve( count_ );
+            const std::size_t e = StorageTraits::Size( *storage_ );
+            for( std::size_t i = e - count_; i != e; ++i ) {
+                v.push_back( ToAny( StorageTraits::Element( *storage_, i ) ) );
+            }
+            valueMap_.insert( std::make_pair( name_, v ) );
+        }
+        return valueMap_;
+    }
+    /// Implementation of IParser::operator[].
+    /// @exception std::logic_error if key not in map.
+    const ValueType& operator[]( const KeyType& k ) const {
+        const Values& v = GetValues();
+        Values::const_iterator i = v.find( k );
+        if( i == v.end() ) throw std::logic_error( "Cannot find value" );
+        return i->second;
+    }
+    /// Implementation of IParser::Clone.
+    RepeatParser* Clone() const { return new RepeatParser( *this ); }
+
+private:
+    template < typename T >
+    static ValueType ToAny( const T& v ) { return ValueType( v ); }
+    template < typename T, std::size_t N >
+    static ValueType ToAny( const std::array< T, N >& a ) {
+        return ValueType( std::vector< ValueType >( a.begin(), a.end() ) );
+    }
+    /// Advances to first non-blank character or @c EOF.
+    void SkipBlanks( InStream& is ) {
+        if( is.good() ) {
+            Char c = is.get();
+            while( is.good() && parsley::IsSpace( c ) != 0  ) c = is.get();
+            if( is.good() ) is.unget();
+        }
+    }
+    /// Parser to apply.
+    ParserT parser_;
+    /// Identifier for parsed values in returned value map.
+    ValueID name_;
+    /// Minimum amount of times to execute parser.
+    int countMin_;
+    /// Maximum amount of times to execute parser or < 0 to signal
+    /// an indefinite amount.
+    int countMax_;
+    /// Skip blanks flag.
+    bool skipBlanks_;
+    /// Number of values parsed by last invocation of Parse.
+    int count_;
+    /// Storage used when no client storage provided.
+    Storage owned_;
+    /// Pointer to current storage.
+    Storage* storage_;
+    /// Optional sink receiving values in place of storage.
+    Sink sink_;
+    /// Value map, populated only when RepeatParser::GetValues invoked.
+    mutable Values valueMap_;
+};
+
+//------------------------------------------------------------------------------
+/// @brief Parser for fixed-column records.
+///
+/// Reads one line and slices it according to a column schema; each column is
+/// identified by a name, the first and last character position and a type.
+/// Positions are 1-based and inclusive to match the way fixed-column formats
+/// such as PDB are documented.
+/// Numeric columns are converted directly from the characters in the line
+/// buffer; blanks are only skipped inside the column boundaries, no other
+/// parser is invoked and no intermediate string is created.
+/// Columns lying past the end of the line or containing only blanks are
+/// reported as blank and not inserted into the value map.
+/// If a tag is specified the line is validated only if it begins with the
+/// tag text.
+/// @code
+/// ColumnRecordParser atom( PDBAtomColumns(), "ATOM" );
+/// if( atom.Parse( is ) ) {
+///     const double x = atom.GetFloat( atom.Index( "x" ) );
+///     ...
+/// }
+/// @endcode
+/// @ingroup Parsers
+class ColumnRecordParser : public IParser {
+public:
+    typedef Values::value_type::second_type ValueType;
+    typedef Values::key_type KeyType;
+    typedef InStream::char_type Char;
+    /// Column type.
+    enum Type { TEXT, INT, FLOAT };
+    /// Column schema.
+    struct Column {
+        Column( const ValueID& n, int f, int l, Type t = TEXT )
+            : name( n ), first( f ), last( l ), type( t ) {}
+        /// Name used as key in value map.
+        ValueID name;
+        /// Position of first character, 1-based.
+        int first;
+        /// Position of last character, 1-based, inclusive.
+        int last;
+        /// Value type.
+        Type type;
+    };
+    typedef std::vector< Column > Columns;
+    /// Constructor.
+    /// @param columns column schema
+    /// @param tag if not empty only lines beginning with @c tag are parsed
+    ColumnRecordParser( const Columns& columns, const String& tag = String() )
+        : columns_( columns ), fields_( columns.size() ), tag_( tag ) {}
+    /// IParser::Parse implementation: reads the line up to and including the
+    /// end of line character and converts the numeric columns.
+    /// @return @c false if the tag does not match, a numeric column contains
+    /// invalid characters or an @c INT column does not fit into a @c long;
+    /// the stream is rewound in this case.
+    bool Parse( InStream& is ) {
+        valueMap_.clear();
+        line_.clear();
+        if( !is.good() ) return false;
+        bool ok = false; {
+        REWIND r( ok, is );
+        ok = ReadLine( is ) && Convert();
+        }
+        return ok;
+    }
+    /// @return index of named column or -1 if not found.
+    int Index( const ValueID& name ) const {
+        for( Columns::size_type i = 0; i != columns_.size(); ++i ) {
+            if( columns_[ i ].name == name ) return int( i );
+        }
+        return -1;
+    }
+    /// @return @c true if column is blank or past the end of the line.
+    bool IsBlank( int i ) const { return fields_[ i ].blank; }
+    /// @return value of @c FLOAT or @c INT column.
+    double GetFloat( int i ) const { return fields_[ i ].number; }
+    /// @return value of @c INT column.
+    long GetInt( int i ) const { return fields_[ i ].integer; }
+    /// @return text of column, leading and trailing blanks removed.
+    String GetText( int i ) const {
+        const Field& f = fields_[ i ];
+        return String( line_.data() + f.begin, line_.data() + f.end );
+    }
+    /// @return last parsed line.
+    const String& GetLine() const { return line_; }
+    /// IParser::GetValues implementation: the value map is populated on the
+    /// first invocation after each successful parse.
+    const Values& GetValues() const {
+        if( valueMap_.empty() && !line_.empty() ) {
+            for( Columns::size_type i = 0; i != columns_.size(); ++i ) {
+                if( fields_[ i ].blank ) continue;
+                const Column& c = columns_[ i ];
+                if( c.type == FLOAT ) {
+                    valueMap_.insert( std::make_pair( c.name, GetFloat( i ) ) );
+                } else if( c.type == INT ) {
+                    valueMap_.insert( std::make_pair( c.name, GetInt( i ) ) );
+                } else {
+                    valueMap_.insert( std::make_pair( c.name, GetText( i ) ) );
+                }
+            }
+        }
+        return valueMap_;
+    }
+    /// IParser::operator[] implementation.
+    const ValueType& operator[]( const KeyType& k ) const {
+        const Values& v = GetValues();
+        Values::const_iterator i = v.find( k );
+        if( i == v.end() ) throw std::logic_error( "Cannot find value" );
+        return i->second;
+    }
+    /// IParser::Clone implementation.
+    ColumnRecordParser* Clone() const { return new ColumnRecordParser( *this ); }
+    /// IParser::Project implementation: columns not in the set are neither
+    /// sliced nor converted and are reported as blank; note that the content
+    /// of skipped numeric columns is not validated.
+    void Project( const ValueIDs& ids ) {
+        for( Columns::size_type i = 0; i != columns_.size(); ++i ) {
+            fields_[ i ].skip = ids.find( columns_[ i ].name ) == ids.end();
+            if( fields_[ i ].skip ) fields_[ i ].blank = true;
+        }
+    }
+
+private:
+    /// Sliced column: [begin, end) range in line buffer and converted value;
+    /// @c INT columns store the exact value in @c integer and its conversion
+    /// to floating point in @c number.
+    struct Field {
+        Field() : begin( 0 ), end( 0 ), number( 0 ), integer( 0 ),
+                  blank( true ), skip( false ) {}
+        String::size_type begin;
+        String::size_type end;
+        double number;
+        long integer;
+        bool blank;
+        /// Set by ColumnRecordParser::Project.
+        bool skip;
+    };
+    /// Reads characters up to the end of line; a trailing @c '\\r' is
+    /// removed.
+    bool ReadLine( InStream& is ) {
+        Char c = 0;
+        while( is.good() ) {
+            c = is.get();
+            if( !is.good() || c == '\n' ) break;
+            if( line_.size() < tag_.size() && c != tag_[ line_.size() ] ) {
+                return false;
+            }
+            line_.push_back( c );
+        }
+        if( !line_.empty() && line_[ line_.size() - 1 ] == '\r' ) {
+            line_.erase( line_.size() - 1 );
+        }
+        return line_.size() >= tag_.size() && ( !line_.empty() || c == '\n' );
+    }
+    /// Slices line and converts numeric columns.
+    bool Convert() {
+        const char* const data = line_.data();
+        for( Columns::size_type i = 0; i != columns_.size(); ++i ) {
+            const Column& c = columns_[ i ];
+            Field& f = fields_[ i ];
+            if( f.skip ) continue;
+            f.number = 0;
+            f.integer = 0;
+            f.begin = std::min( String::size_type( c.first - 1 ), line_.size() );
+            f.end = std::min( String::size_type( c.last ), line_.size() );
+            while( f.begin < f.end && IsSpace( data[ f.begin ] ) ) ++f.begin;
+            while( f.end > f.begin && IsSpace( data[ f.end - 1 ] ) ) --f.end;
+            f.blank = f.begin == f.end;
+            if( f.blank || c.type == TEXT ) continue;
+            const char* b = data + f.begin;
+            const char* e = data + f.end;
+            if( c.type == INT ) {
+                if( !ToInt( b, e, f.integer ) ) return false;
+                f.number = double( f.integer );
+            } else if( !ToFloat( b, e, f.number ) ) return false;
+        }
+        return true;
+    }
+    /// Converts [b, e) to integer.
+    /// @return @c false if the text is not an integer or its absolute value
+    /// is greater than the maximum value of type @c long.
+    static bool ToInt( const char* b, const char* e, long& v ) {
+        const bool negative = *b == '-';
+        if( *b == '-' || *b == '+' ) ++b;
+        if( b == e ) return false;
+        const long max = std::numeric_limits< long >::max();
+        long n = 0;
+        for( ; b != e; ++b ) {
+            if( !IsDigit( *b ) ) return false;
+            const long d = *b - '0';
+            if( n > ( max - d ) / 10 ) return false;
+            n = 10 * n + d;
+        }
+        v = negative ? -n : n;
+        return true;
+    }
+    /// Converts [b, e) to floating point; accepts @c E or @c D as exponent
+    /// identifier. Up to 15 significant digits and exponents in range
+    /// [-22, 22] are converted exactly through a single multiplication or
+    /// division by a power of ten, other values are converted with
+    /// @c strtod.
+    static bool ToFloat( const char* b, const char* e, double& v ) {
+        static const double POW10[] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+            1e22 };
+        const char* const start = b;
+        const bool negative = *b == '-';
+        if( *b == '-' || *b == '+' ) ++b;
+        unsigned long long mantissa = 0;
+        int digits = 0;
+        int scale = 0;
+        bool valid = false;
+        for( ; b != e && IsDigit( *b ); ++b, valid = true ) {
+            if( digits < 19 ) { mantissa = 10 * mantissa + ( *b - '0' ); }
+            else ++scale;
+            if( mantissa != 0 ) ++digits;
+        }
+        if( b != e && *b == '.' ) {
+            for( ++b; b != e && IsDigit( *b ); ++b, valid = true ) {
+                if( digits < 19 ) {
+                    mantissa = 10 * mantissa + ( *b - '0' );
+                    --scale;
+                }
+                if( mantissa != 0 ) ++digits;
+            }
+        }
+        if( !valid ) return false;
+        if( b != e ) {
+            if( *b != 'e' && *b != 'E' && *b != 'd' && *b != 'D' ) return false;
+            ++b;
+            const bool negExp = b != e && *b == '-';
+            if( b != e && ( *b == '-' || *b == '+' ) ) ++b;
+            if( b == e ) return false;
+            int exponent = 0;
+            for( ; b != e; ++b ) {
+                if( !IsDigit( *b ) ) return false;
+                if( exponent < 10000 ) exponent = 10 * exponent + ( *b - '0' );
+            }
+            scale += negExp ? -exponent : exponent;
+        }
+        if( digits <= 15 && scale >= -22 && scale <= 22 ) {
+            const double m = double( mantissa );
+            v = scale < 0 ? m / POW10[ -scale ] : m * POW10[ scale ];
+            if( negative ) v = -v;
+            return true;
+        }
+        // slow path: copy into local buffer and convert through strtod,
+        // fields not fitting into the buffer are copied into a string
+        char buf[ 64 ];
+        std::string longField;
+        const std::size_t n = std::size_t( e - start );
+        char* p = buf;
+        if( n >= sizeof( buf ) ) {
+            longField.resize( n + 1 );
+            p = &longField[ 0 ];
+        }
+        for( std::size_t i = 0; i != n; ++i ) {
+            const char c = start[ i ];
+            p[ i ] = c == 'd' || c == 'D' ? 'E' : c;
+        }
+        p[ n ] = '\0';
+        v = std::strtod( p, 0 );
+        return true;
+    }
+    /// Column schema.
+    Columns columns_;
+    /// Sliced columns, one per column in schema.
+    std::vector< Field > fields_;
+    /// Record tag.
+    String tag_;
+    /// Line buffer: storage is reused across invocations of Parse.
+    String line_;
+    /// Value map, populated only when ColumnRecordParser::GetValues invoked.
+    mutable Values valueMap_;
+};
+
+/// @brief Column schema of PDB @c ATOM and @c HETATM records.
+/// @ingroup Parsers
+inline ColumnRecordParser::Columns PDBAtomColumns() {
+    typedef ColumnRecordParser CRP;
+    CRP::Column c[] = {
+        CRP::Column( "record",      1,  6 ),
+        CRP::Column( "serial",      7, 11, CRP::INT ),
+        CRP::Column( "name",       13, 16 ),
+        CRP::Column( "altLoc",     17, 17 ),
+        CRP::Column( "resName",    18, 20 ),
+        CRP::Column( "chainID",    22, 22 ),
+        CRP::Column( "resSeq",     23, 26, CRP::INT ),
+        CRP::Column( "iCode",      27, 27 ),
+        CRP::Column( "x",          31, 38, CRP::FLOAT ),
+        CRP::Column( "y",          39, 46, CRP::FLOAT ),
+        CRP::Column( "z",          47, 54, CRP::FLOAT ),
+        CRP::Column( "occupancy",  55, 60, CRP::FLOAT ),
+        CRP::Column( "tempFactor", 61, 66, CRP::FLOAT ),
+        CRP::Column( "element",    77, 78 ),
+        CRP::Column( "charge",     79, 80 )
+    };
+    return CRP::Columns( c, c + sizeof( c ) / sizeof( c[ 0 ] ) );
+}
+
 
 /// @brief Pass through parser: always validates the input.
 ///
@@ -1,4 +1,9 @@
+#pragma once
 #include <limits>
+#include <map>
+#include <deque>
+#include <functional>
+#include <vector>
 #include "InStream.h"
 #include "Parser.h"
 
@@ -8,8 +13,104 @@ using NonTerminal = Parser;
 
 enum class EvalState {BEGIN, PASS, FAIL};
 
+///Event masks: select the EvalState events dispatched to rule actions by
+///Grammar.
+enum EvalEvents {NO_EVENTS = 0, BEGIN_EVENT = 1, PASS_EVENT = 2,
+                 FAIL_EVENT = 4, ALL_EVENTS = 7};
+
 using EvalFun = std::function< bool (InStream&) >;
 
+///Memoization policy:
+/// - NONE: rule always evaluated
+/// - LAST: result at last evaluated position recorded in rule closure
+/// - FULL: result and end position recorded in MemoTable for each position
+enum class MemoPolicy {NONE, LAST, FULL};
+
+///Packrat memoization table: records the result of rule evaluation and the
+///end position for each (position, rule) pair.
+///Entries at positions before the committed position are evicted; the
+///committed position is moved explicitly through Commit or automatically
+///to keep only the entries within a window behind the last recorded position.
+///Note that action callbacks are not invoked when a result is read from the
+///table: use FULL memoization only for rules whose callbacks have no side
+///effects or that have no callbacks.
+template < typename KeyT >
+class MemoTable {
+public:
+    ///Recorded result.
+    struct Entry {
+        bool pass;
+        StreamOff end;
+    };
+    ///Constructor.
+    ///@param defaultPolicy policy for rules with no policy set
+    ///@param window if > 0 maximum distance from last recorded position of
+    ///       recorded entries
+    MemoTable(MemoPolicy defaultPolicy = MemoPolicy::FULL,
+              StreamOff window = 0)
+        : default_(defaultPolicy), window_(window), committed_(0),
+          size_(0), hits_(0), misses_(0) {}
+    ///Set policy for rule.
+    void SetPolicy(KeyT k, MemoPolicy p) { policies_[k] = p; }
+    ///Returns policy for rule.
+    MemoPolicy GetPolicy(KeyT k) const {
+        auto i = policies_.find(k);
+        return i == policies_.end() ? default_ : i->second;
+    }
+    ///Returns recorded entry or NULL if not found.
+    const Entry* Find(KeyT k, StreamOff pos) {
+        auto c = table_.find(pos);
+        if(c != table_.end()) {
+            auto e = c->second.find(k);
+            if(e != c->second.end()) {
+                ++hits_;
+                return &e->second;
+            }
+        }
+        ++misses_;
+        return nullptr;
+    }
+    ///Record result; ignored if position before committed position.
+    void Insert(KeyT k, StreamOff pos, bool pass, StreamOff end) {
+        if(pos < committed_) return;
+        const Entry e = {pass, end};
+        if(table_[pos].insert(std::make_pair(k, e)).second) ++size_;
+        if(window_ > 0 && pos - window_ > committed_) Commit(pos - window_);
+    }
+    ///Evict all entries before position: input before position won't be
+    ///parsed again.
+    void Commit(StreamOff pos) {
+        if(pos <= committed_) return;
+        committed_ = pos;
+        auto e = table_.lower_bound(pos);
+        for(auto i = table_.begin(); i != e; ++i) size_ -= i->second.size();
+        table_.erase(table_.begin(), e);
+    }
+    ///Remove all entries.
+    void Clear() {
+        table_.clear();
+        committed_ = 0;
+        size_ = 0;
+    }
+    ///Returns committed position.
+    StreamOff Committed() const { return committed_; }
+    ///Returns number of recorded entries.
+    std::size_t Size() const { return size_; }
+    ///Returns number of successful lookups.
+    std::size_t Hits() const { return hits_; }
+    ///Returns number of failed lookups.
+    std::size_t Misses() const { return misses_; }
+private:
+    std::map< StreamOff, std::map< KeyT, Entry > > table_;
+    std::map< KeyT, MemoPolicy > policies_;
+    MemoPolicy default_;
+    StreamOff window_;
+    StreamOff committed_;
+    std::size_t size_;
+    std::size_t hits_;
+    std::size_t misses_;
+};
+
 
 ///@todo add operator () to parser so that function is can eventually
 ///be made independent of Parser class and ivoke operator() instead
@@ -27,16 +128,28 @@ using EvalFun = std::function< bool (InStream&) >;
                 //.., NonTerminal(),...
                 ActionMapT& am,
                 ContextT& c,
-                bool cback = true) {
+                bool cback = true,
+                MemoTable< KeyT >* memo = nullptr) {
      std::size_t sp = std::numeric_limits<std::size_t>::max();
      bool last = false;
-     return [cback, last, sp, k, &em, p, &am, &c](InStreamT& is)
+     return [cback, last, sp, k, &em, p, &am, &c, memo](InStreamT& is)
        mutable -> bool { //mutable required: sp and last to be
                          //modified by function 
+       const MemoPolicy policy = memo ? memo->GetPolicy(k) 
+                                      : MemoPolicy::LAST;
+       const StreamOff pos = is.tellg();
+       //packrat memoization: move to recorded end position and
+       //return recorded result
+       if(policy == MemoPolicy::FULL && pos >= 0) {
+         if(auto e = memo->Find(k, pos)) {
+           is.seekg(e->end);
+           return e->pass;
+         }
+       }
        //~memoization: if evaluation already performed at stream
        //position return result (true or false)
        //at stream position
-       if(is.tellg() == sp) return last;
+       if(policy == MemoPolicy::LAST && is.tellg() == sp) return last;
        //make sure key is in map
        assert(em.find(k) != em.end());
        //if callback requested make sure callback available in
@@ -75,61 +188,103 @@ using EvalFun = std::function< bool (InStream&) >;
        //record stream position and result in clojure
        sp = i;
        last = ret;
+       if(policy == MemoPolicy::FULL && pos >= 0) {
+         const StreamOff end = is.tellg();
+         if(end >= 0) memo->Insert(k, pos, ret, end);
+       }
        return ret;
      };
    }
 
-EvalFun OR() {
-    return [](InStream&) { return false; };
-}
+using EvalFuns = std::vector< EvalFun >;
 
-template < typename F, typename...Fs >
-EvalFun OR(F f, Fs...fs) {
-    return [=](InStream& is)  {
-        bool pass = false;
-        //REWIND r(pass, is);
-        pass = f(is);
-        if(pass) return true;
-        return OR(fs...)(is);
-    };
+///N-ary sequence: children evaluated in order, stream rewound to the
+///initial position if any child fails.
+struct Sequence {
+    EvalFuns children;
+    bool operator()(InStream& is) const {
+        bool pass = true;
+        REWIND r(pass, is);
+        for(auto& f: children) {
+            pass = f(is);
+            if(!pass) break;
+        }
+        return pass;
+    }
+};
+
+///N-ary ordered choice: first successful child wins; children are
+///responsible for rewinding the stream on failure.
+struct Choice {
+    EvalFuns children;
+    bool operator()(InStream& is) const {
+        for(auto& f: children) {
+            if(f(is)) return true;
+            //failure after cut: no other alternative can be tried
+            if(is.cut_failed()) return false;
+        }
+        return false;
+    }
+};
+
+///Appends node to children; children of nodes of type NodeT are appended
+///in place of the node itself, to keep the evaluation tree flat.
+template < typename NodeT >
+void FlattenNode(EvalFuns& children, const EvalFun& f) {
+    if(const NodeT* n = f.template target< NodeT >()) {
+        children.insert(children.end(), n->children.begin(),
+                        n->children.end());
+    } else children.push_back(f);
 }
 
+template < typename NodeT >
+void Flatten(EvalFuns&) {}
 
-EvalFun AND() {
-    return [](InStream& is) { return true; };
+template < typename NodeT, typename F, typename...Fs >
+void Flatten(EvalFuns& children, F f, Fs...fs) {
+    FlattenNode< NodeT >(children, f);
+    Flatten< NodeT >(children, fs...);
 }
 
-template < typename F, typename...Fs >
-EvalFun AND(F f, Fs...fs) {
-    return [=](InStream& is) {
-        bool pass = false;
-        REWIND r(pass, is);
-        pass = f(is);
-        if(!pass) return false;
-        pass = AND(fs...)(is);
-        return pass;
-    };
+template < typename...Fs >
+EvalFun OR(Fs...fs) {
+    Choice c;
+    c.children.reserve(sizeof...(Fs));
+    Flatten< Choice >(c.children, fs...);
+    return c;
 }
 
-template < typename F >
-EvalFun ZM(F f) {
-    return [=](InStream& is) {
-        while(!is.eof() && is.good() && f(is));
-        return true;
-    };
+template < typename...Fs >
+EvalFun AND(Fs...fs) {
+    Sequence s;
+    s.children.reserve(sizeof...(Fs));
+    Flatten< Sequence >(s.children, fs...);
+    return s;
 }
 
-template < typename F >
-EvalFun OM(F f) {
-    return [=](InStream& is) {
+///Zero or more repetitions, stops at end of input.
+struct ZeroOrMore {
+    EvalFun f;
+    bool operator()(InStream& is) const {
+        while(!is.eof() && is.good() && f(is));
+        return !is.cut_failed();
+    }
+};
+
+///One or more repetitions, stops at end of input.
+struct OneOrMore {
+    EvalFun f;
+    bool operator()(InStream& is) const {
         if(!f(is)) return false;
-        return ZM(f)(is);
-    };
-}
+        while(!is.eof() && is.good() && f(is));
+        return !is.cut_failed();
+    }
+};
 
-template < typename F >
-EvalFun ZO(F f) {
-    return [=](InStream& is) {
+///Zero or one occurrence.
+struct ZeroOrOne {
+    EvalFun f;
+    bool operator()(InStream& is) const {
       //return true if f fails (zero)
       //or if f succeeds (one) and following
       //call to f fails:
@@ -137,8 +292,24 @@ EvalFun ZO(F f) {
       //and the second term is evaluated: if second term
       //fails then !false == true is returned meaning
       //only first f(is) succeeded
-      return !f(is) || !f(is);
-    };         
+      const bool pass = !f(is) || !f(is);
+      return pass && !is.cut_failed();
+    }
+};
+
+template < typename F >
+EvalFun ZM(F f) {
+    return ZeroOrMore{f};
+}
+
+template < typename F >
+EvalFun OM(F f) {
+    return OneOrMore{f};
+}
+
+template < typename F >
+EvalFun ZO(F f) {
+    return ZeroOrOne{f};
 }
 
 template < typename F >
@@ -160,13 +331,33 @@ EvalFun NOT(F f) {
     };
 }
 
+//Cut: input before current position cannot be parsed again, any failure
+//past this point is a hard failure i.e. enclosing alternatives are not tried;
+//use InStream::cut_clear() to resume parsing after a hard failure
+inline EvalFun CUT() {
+    return [](InStream& is) {
+        is.cut();
+        return true;
+    };
+}
+
+//Cut and evict memoized results before current position
+template < typename KeyT >
+EvalFun CUT(MemoTable< KeyT >& memo) {
+    return [&memo](InStream& is) {
+        is.cut();
+        memo.Commit(is.tellg());
+        return true;
+    };
+}
+
 //Returns a function which forwards calls to other function in grammar
 //map
 template < typename KeyT, typename EvalMapT, typename ActionMapT,
 typename ContextT >
 EvalFun Call(KeyT key, const EvalMapT& em, ActionMapT& am, 
-             ContextT& c, bool cback) {
-    return MakeTermEval<InStream>(key, em, Parser(), am, c, cback);
+             ContextT& c, bool cback, MemoTable< KeyT >* memo = nullptr) {
+    return MakeTermEval<InStream>(key, em, Parser(), am, c, cback, memo);
 }
 
 #define MAKE_CALL(K, G, AM, CTX) \
@@ -175,11 +366,219 @@ EvalFun Call(KeyT key, const EvalMapT& em, ActionMapT& am,
 #define MAKE_CBCALL(K, G, AM, CTX) \
 [& G, & AM, & CTX](K t) { return Call(t, G, AM, CTX, true); }
 
+#define MAKE_MEMOCALL(K, G, AM, CTX, M) \
+[& G, & AM, & CTX, & M](K t, bool cback) { \
+return Call(t, G, AM, CTX, cback, &M); }
+
 #define MAKE_EVAL(K, G, AM, CTX) \
 [& G, & AM, & CTX](TERM t, Parser p) { \
 return MakeTermEval<InStream>(t, g, p, am, ctx); \
 }
 
+template < typename KeyT, typename ActionMapT, typename ContextT >
+class GrammarVM;
+
+///Grammar with rules stored in a dense table: rule references created
+///through Call, CBCall and Term hold the index of the referenced rule and
+///actions are copied from the action map into the table by Link, no map
+///lookup is performed while parsing.
+///Rules are defined with the same syntax used with maps:
+///@code
+///Grammar< TERM, ActionMap, Ctx > g(am, ctx);
+///auto n = [&g](TERM t) { return g.Call(t); };
+///g[SUM] = (n(PRODUCT), *(n(PLUS), n(PRODUCT)));
+///...
+///g.Link();
+///g[SUM](is);
+///@endcode
+///Rule references capture the address of the grammar which is therefore
+///not copyable.
+///A grammar can be reused to parse multiple inputs: SetContext binds the
+///context passed to actions and Reset discards the results of the last
+///evaluation recorded at each call site, which would otherwise be returned
+///when a rule is invoked at the same position in a new input.
+///Actions receive all the events unless an event mask is set through
+///SetEvents: events not in the mask are not dispatched and are treated as if
+///the action returned true for BEGIN and the parsing result for PASS and FAIL;
+///parsed values are not retrieved from terminals if PASS and FAIL are not
+///dispatched.
+template < typename KeyT, typename ActionMapT, typename ContextT >
+class Grammar {
+public:
+    using Action = typename ActionMapT::mapped_type;
+    ///Constructor.
+    ///@param am action map, read by Link
+    ///@param c context passed to actions
+    ///@param memo optional memoization table
+    Grammar(ActionMapT& am, ContextT& c, MemoTable< KeyT >* memo = nullptr)
+        : am_(am), ctx_(&c), memo_(memo), events_(ALL_EVENTS),
+          linked_(false), generation_(0) {}
+    ///Constructor, context must be set with SetContext before parsing.
+    ///@param am action map, read by Link
+    ///@param memo optional memoization table
+    explicit Grammar(ActionMapT& am, MemoTable< KeyT >* memo = nullptr)
+        : am_(am), ctx_(nullptr), memo_(memo), events_(ALL_EVENTS),
+          linked_(false), generation_(0) {}
+    Grammar(const Grammar&) = delete;
+    Grammar& operator=(const Grammar&) = delete;
+    ///Returns rule, added if not present.
+    EvalFun& operator[](KeyT k) { return rules_[Index(k)].eval; }
+    ///Returns function evaluating rule k, callbacks invoked if cback is true.
+    EvalFun Call(KeyT k, bool cback = false) {
+        return RuleCall(this, Index(k), cback);
+    }
+    ///Returns function evaluating rule k and invoking callbacks.
+    EvalFun CBCall(KeyT k) { return Call(k, true); }
+    ///Returns function applying parser and invoking callbacks for rule k
+    ///with parsed values if cback is true.
+    EvalFun Term(KeyT k, const Parser& p, bool cback = true) {
+        return TermCall(this, Index(k), p, cback);
+    }
+    ///Sets default event mask, used for rules with no mask set.
+    void SetEvents(unsigned mask) { events_ = mask; }
+    ///Sets event mask for one or more rules.
+    template < typename...KeysT >
+    void SetEvents(unsigned mask, KeyT k, KeysT...ks) {
+        ruleEvents_[k] = mask;
+        SetEvents(mask, ks...);
+    }
+    ///Copies actions and event masks into rule table; must be invoked
+    ///after all the rules, actions and event masks have been defined.
+    void Link() {
+        for(auto& r: rules_) {
+            auto a = am_.find(r.key);
+            r.action = a != am_.end() ? a->second : Action();
+            auto e = ruleEvents_.find(r.key);
+            r.events = e != ruleEvents_.end() ? e->second : events_;
+        }
+        linked_ = true;
+    }
+    ///Sets context passed to actions.
+    void SetContext(ContextT& c) { ctx_ = &c; }
+    ///Discards state of previous parsing, must be invoked before parsing
+    ///a new input: LAST memoization state is invalidated and the entries
+    ///of the memoization table, if any, are removed.
+    void Reset() {
+        ++generation_;
+        if(memo_) memo_->Clear();
+    }
+    ///Returns index of rule, rule is added if not present.
+    std::size_t Index(KeyT k) {
+        auto i = index_.find(k);
+        if(i != index_.end()) return i->second;
+        rules_.push_back(Rule(k));
+        index_.insert(std::make_pair(k, rules_.size() - 1));
+        return rules_.size() - 1;
+    }
+    ///Returns number of rules.
+    std::size_t Size() const { return rules_.size(); }
+private:
+    friend class GrammarVM< KeyT, ActionMapT, ContextT >;
+    ///Rule table entry.
+    struct Rule {
+        Rule(KeyT k) : key(k), events(ALL_EVENTS) {}
+        KeyT key;
+        EvalFun eval;
+        Action action;
+        unsigned events;
+    };
+    ///Returns empty value map passed to actions of non-terminals.
+    static const Values& NoValues() {
+        static const Values v;
+        return v;
+    }
+    ///Evaluates rule i, if p is not NULL p is used to parse the input in
+    ///place of the rule function; sp and last hold the position and result
+    ///of the last evaluation at the call site, gen the generation in which
+    ///they were recorded.
+    bool Eval(std::size_t i, bool cback, Parser* p, StreamOff& sp,
+              bool& last, unsigned& gen, InStream& is) {
+        Rule& r = rules_[i];
+        const MemoPolicy policy = memo_ ? memo_->GetPolicy(r.key)
+                                        : MemoPolicy::LAST;
+        const StreamOff pos = is.tellg();
+        if(policy == MemoPolicy::FULL && pos >= 0) {
+            if(auto e = memo_->Find(r.key, pos)) {
+                is.seekg(e->end);
+                return e->pass;
+            }
+        }
+        if(policy == MemoPolicy::LAST && pos == sp && gen == generation_)
+            return last;
+        assert(!cback || (linked_ && (r.action || !r.events)));
+        assert(!(cback && r.events) || ctx_);
+        const unsigned events = cback ? r.events : unsigned(NO_EVENTS);
+        bool ret = true;
+        if(events & BEGIN_EVENT) {
+            ret = r.action(r.key, NoValues(), *ctx_, EvalState::BEGIN);
+        }
+        if(p) ret = ret && p->Parse(is);
+        else {
+            assert(r.eval);
+            ret = ret && r.eval(is);
+        }
+        if(events & (ret ? PASS_EVENT : FAIL_EVENT)) {
+            const EvalState s = ret ? EvalState::PASS : EvalState::FAIL;
+            ret = r.action(r.key, p ? p->GetValues() : NoValues(), *ctx_, s)
+                  && ret;
+        }
+        sp = pos;
+        last = ret;
+        gen = generation_;
+        if(policy == MemoPolicy::FULL && pos >= 0) {
+            const StreamOff end = is.tellg();
+            if(end >= 0) memo_->Insert(r.key, pos, ret, end);
+        }
+        return ret;
+    }
+    ///Reference to rule.
+    struct RuleCall {
+        RuleCall(Grammar* g, std::size_t i, bool cback)
+            : g(g), i(i), cback(cback), sp(-1), last(false), gen(0) {}
+        bool operator()(InStream& is) {
+            return g->Eval(i, cback, nullptr, sp, last, gen, is);
+        }
+        Grammar* g;
+        std::size_t i;
+        bool cback;
+        StreamOff sp;
+        bool last;
+        unsigned gen;
+    };
+    ///Terminal rule.
+    struct TermCall {
+        TermCall(Grammar* g, std::size_t i, const Parser& p, bool cback)
+            : g(g), i(i), p(p), cback(cback), sp(-1), last(false), gen(0) {}
+        bool operator()(InStream& is) {
+            return g->Eval(i, cback, &p, sp, last, gen, is);
+        }
+        Grammar* g;
+        std::size_t i;
+        Parser p;
+        bool cback;
+        StreamOff sp;
+        bool last;
+        unsigned gen;
+    };
+    ///Rule table; std::deque: references to rules are not invalidated when
+    ///new rules are added during grammar definition.
+    std::deque< Rule > rules_;
+    ///Key to index map, used only at grammar definition time.
+    std::map< KeyT, std::size_t > index_;
+    ActionMapT& am_;
+    ContextT* ctx_;
+    MemoTable< KeyT >* memo_;
+    ///Default event mask.
+    unsigned events_;
+    ///Per-rule event masks, copied into rule table by Link.
+    std::map< KeyT, unsigned > ruleEvents_;
+    bool linked_;
+    ///Incremented by Reset, call site state recorded in a previous
+    ///generation is ignored.
+    unsigned generation_;
+};
+
+//binary operators build flat n-ary nodes: a & b & c -> AND(a, b, c)
 EvalFun operator&(const EvalFun& e1, const EvalFun& e2) {
     return AND(e1, e2);
 }
@@ -0,0 +1,722 @@
+#pragma once
+//Grammar DSL: run-time construction of peg.h grammars and generation of
+//specialized C++ recursive descent parsers
+
+#include <bitset>
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "peg.h"
+
+namespace parsley {
+
+///Grammar DSL syntax:
+///@code
+///#comment
+///rule    <- expression ;
+///sum     <- product (('+' / '-') product)* ;
+///digits  <- [0-9]+ ;
+///text    <- "abc" / 'x' / . ;
+///word    <- [^ \t\r\n]+ ;
+///@endcode
+///- first rule is the start rule
+///- e1 e2: sequence; e1 / e2: ordered choice
+///- e*, e+, e?: zero or more, one or more, optional
+///- 'abc', "abc": literal; [a-z_]: character class, [^...]: negated class
+///- .: any character
+///- escape sequences in literals and classes: \n \r \t \\ \' \" \] \- \^
+///Rules are evaluated with PEG semantics through the peg.h combinators, see
+///BuildGrammar, or through the C++ code generated by GeneratePegParser.
+
+///Grammar DSL expression.
+struct PegExpr {
+    enum Type {LITERAL, CLASS, ANY, RULE, SEQUENCE, CHOICE, ZERO_OR_MORE,
+               ONE_OR_MORE, OPTIONAL};
+    PegExpr(Type t = SEQUENCE) : type(t), rule(0) {}
+    Type type;
+    ///Literal text or referenced rule name.
+    std::string text;
+    ///Characters matched by CLASS.
+    std::bitset< 256 > chars;
+    ///Index of referenced rule, resolved after parsing.
+    std::size_t rule;
+    std::vector< PegExpr > children;
+};
+
+///Grammar DSL rule.
+struct PegRule {
+    std::string name;
+    PegExpr expr;
+};
+
+///Grammar DSL parsed representation.
+struct PegGrammar {
+    std::vector< PegRule > rules;
+    ///Returns rule index or rules.size() if rule not found.
+    std::size_t Find(const std::string& name) const {
+        for(std::size_t i = 0; i != rules.size(); ++i)
+            if(rules[i].name == name) return i;
+        return rules.size();
+    }
+};
+
+///Grammar DSL reader.
+class PegGrammarReader {
+public:
+    ///Parses grammar text.
+    ///@throw std::runtime_error with line number on syntax errors,
+    ///references to undefined rules and '*' or '+' applied to expressions
+    ///that match the empty string, which would loop forever
+    PegGrammar Read(const std::string& text) {
+        text_ = text;
+        pos_ = 0;
+        line_ = 1;
+        PegGrammar g;
+        std::vector< int > lines;
+        Skip();
+        while(pos_ != text_.size()) {
+            lines.push_back(line_);
+            PegRule r;
+            r.name = Identifier();
+            if(g.Find(r.name) != g.rules.size())
+                Error("rule '" + r.name + "' already defined");
+            Expect("<-");
+            r.expr = Choice();
+            Expect(";");
+            g.rules.push_back(r);
+        }
+        if(g.rules.empty()) Error("empty grammar");
+        for(std::size_t i = 0; i != g.rules.size(); ++i) {
+            line_ = lines[i];
+            Resolve(g, g.rules[i].expr);
+        }
+        //least fixed point: a rule is nullable only if proven so
+        std::vector< bool > nullable(g.rules.size(), false);
+        for(bool changed = true; changed;) {
+            changed = false;
+            for(std::size_t i = 0; i != g.rules.size(); ++i) {
+                if(!nullable[i] && Nullable(g.rules[i].expr, nullable))
+                    changed = nullable[i] = true;
+            }
+        }
+        for(std::size_t i = 0; i != g.rules.size(); ++i) {
+            line_ = lines[i];
+            CheckRepetitions(g.rules[i], g.rules[i].expr, nullable);
+        }
+        return g;
+    }
+private:
+    void Error(const std::string& msg) const {
+        std::ostringstream os;
+        os << "line " << line_ << ": " << msg;
+        throw std::runtime_error(os.str());
+    }
+    bool End() const { return pos_ == text_.size(); }
+    char Peek() const { return End() ? '\0' : text_[pos_]; }
+    char Get() {
+        if(End()) Error("unexpected end of grammar");
+        const char c = text_[pos_++];
+        if(c == '\n') ++line_;
+        return c;
+    }
+    ///Skips blanks and comments.
+    void Skip() {
+        while(!End()) {
+            const char c = Peek();
+            if(c == '#') {
+                while(!End() && Peek() != '\n') Get();
+            } else if(c == ' ' || c == '\t' || c == '\r' || c == '\n') Get();
+            else break;
+        }
+    }
+    void Expect(const std::string& s) {
+        if(text_.compare(pos_, s.size(), s) != 0)
+            Error("expected '" + s + "'");
+        for(std::size_t i = 0; i != s.size(); ++i) Get();
+        Skip();
+    }
+    static bool IdentChar(char c, bool first) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'
+               || (!first && c >= '0' && c <= '9');
+    }
+    std::string Identifier() {
+        if(!IdentChar(Peek(), true)) Error("expected rule name");
+        std::string id;
+        while(IdentChar(Peek(), id.empty())) id += Get();
+        Skip();
+        return id;
+    }
+    char Escaped() {
+        const char c = Get();
+        if(c != '\\') return c;
+        const char e = Get();
+        switch(e) {
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case '\\': case '\'': case '"': case ']': case '-': case '^':
+            return e;
+        default: Error(std::string("invalid escape sequence \\") + e);
+        }
+        return e;
+    }
+    PegExpr Choice() {
+        PegExpr e(PegExpr::CHOICE);
+        e.children.push_back(Sequence());
+        while(Peek() == '/') {
+            Expect("/");
+            e.children.push_back(Sequence());
+        }
+        if(e.children.size() == 1) return e.children.front();
+        return e;
+    }
+    PegExpr Sequence() {
+        PegExpr e(PegExpr::SEQUENCE);
+        while(!End() && Peek() != ';' && Peek() != '/' && Peek() != ')')
+            e.children.push_back(Suffix());
+        if(e.children.size() == 1) return e.children.front();
+        return e;
+    }
+    PegExpr Suffix() {
+        PegExpr p = Primary();
+        const char c = Peek();
+        PegExpr::Type t;
+        if(c == '*') t = PegExpr::ZERO_OR_MORE;
+        else if(c == '+') t = PegExpr::ONE_OR_MORE;
+        else if(c == '?') t = PegExpr::OPTIONAL;
+        else return p;
+        Get();
+        Skip();
+        PegExpr e(t);
+        e.children.push_back(p);
+        return e;
+    }
+    PegExpr Primary() {
+        const char c = Peek();
+        if(c == '(') {
+            Expect("(");
+            PegExpr e = Choice();
+            Expect(")");
+            return e;
+        }
+        if(c == '.') {
+            Expect(".");
+            return PegExpr(PegExpr::ANY);
+        }
+        if(c == '\'' || c == '"') {
+            PegExpr e(PegExpr::LITERAL);
+            Get();
+            while(Peek() != c) e.text += Escaped();
+            Get();
+            Skip();
+            if(e.text.empty()) Error("empty literal");
+            return e;
+        }
+        if(c == '[') {
+            PegExpr e(PegExpr::CLASS);
+            Get();
+            const bool negate = Peek() == '^';
+            if(negate) Get();
+            while(Peek() != ']') {
+                const unsigned char first = Escaped();
+                unsigned char last = first;
+                if(Peek() == '-' && pos_ + 1 < text_.size()
+                   && text_[pos_ + 1] != ']') {
+                    Get();
+                    last = Escaped();
+                }
+                if(last < first) Error("invalid character range");
+                for(unsigned i = first; i <= last; ++i) e.chars.set(i);
+            }
+            Get();
+            Skip();
+            if(negate) e.chars.flip();
+            return e;
+        }
+        PegExpr e(PegExpr::RULE);
+        e.text = Identifier();
+        if(Peek() == '<') Error("missing ';' before rule '" + e.text + "'");
+        return e;
+    }
+    void Resolve(const PegGrammar& g, PegExpr& e) {
+        if(e.type == PegExpr::RULE) {
+            e.rule = g.Find(e.text);
+            if(e.rule == g.rules.size())
+                Error("undefined rule '" + e.text + "'");
+        }
+        for(auto& c: e.children) Resolve(g, c);
+    }
+    static bool Nullable(const PegExpr& e, const std::vector< bool >& rules) {
+        switch(e.type) {
+        case PegExpr::LITERAL: case PegExpr::CLASS: case PegExpr::ANY:
+            return false;
+        case PegExpr::RULE:
+            return rules[e.rule];
+        case PegExpr::SEQUENCE: case PegExpr::ONE_OR_MORE:
+            for(auto& c: e.children) if(!Nullable(c, rules)) return false;
+            return true;
+        case PegExpr::CHOICE:
+            for(auto& c: e.children) if(Nullable(c, rules)) return true;
+            return false;
+        default:
+            return true;
+        }
+    }
+    void CheckRepetitions(const PegRule& r, const PegExpr& e,
+                          const std::vector< bool >& nullable) const {
+        if((e.type == PegExpr::ZERO_OR_MORE || e.type == PegExpr::ONE_OR_MORE)
+           && Nullable(e.children.front(), nullable)) {
+            Error("rule '" + r.name + "': '"
+                  + (e.type == PegExpr::ZERO_OR_MORE ? "*" : "+")
+                  + "' applied to expression matching the empty string");
+        }
+        for(auto& c: e.children) CheckRepetitions(r, c, nullable);
+    }
+    std::string text_;
+    std::size_t pos_;
+    int line_;
+};
+
+///Parses grammar DSL text.
+inline PegGrammar ReadPegGrammar(const std::string& text) {
+    return PegGrammarReader().Read(text);
+}
+
+//------------------------------------------------------------------------------
+//Run-time evaluation
+
+///Parser for DSL literals: input rewound on failure.
+class PegLiteralParser : public IParser {
+public:
+    PegLiteralParser(const std::string& s) : text_(s) {}
+    bool Parse(InStream& is) {
+        const InStream::Mark m = is.mark();
+        bool pass = true;
+        for(auto c: text_) {
+            if(!is.good() || is.get() != c || !is.good()) {
+                pass = false;
+                break;
+            }
+        }
+        if(!pass) is.reset(m);
+        is.release(m);
+        return pass;
+    }
+    const Values& GetValues() const { return values_; }
+    const ValueType& operator[](const KeyType&) const {
+        throw std::logic_error("Cannot find value");
+    }
+    PegLiteralParser* Clone() const { return new PegLiteralParser(*this); }
+private:
+    std::string text_;
+    Values values_;
+};
+
+///Parser for DSL character classes: one character in set.
+class PegClassParser : public IParser {
+public:
+    PegClassParser(const std::bitset< 256 >& chars) : chars_(chars) {}
+    bool Parse(InStream& is) {
+        if(!is.good()) return false;
+        const InStream::Mark m = is.mark();
+        const unsigned char c = is.get();
+        const bool pass = is.good() && chars_.test(c);
+        if(!pass) is.reset(m);
+        is.release(m);
+        return pass;
+    }
+    const Values& GetValues() const { return values_; }
+    const ValueType& operator[](const KeyType&) const {
+        throw std::logic_error("Cannot find value");
+    }
+    PegClassParser* Clone() const { return new PegClassParser(*this); }
+private:
+    std::bitset< 256 > chars_;
+    Values values_;
+};
+
+///Defines the rules of a peg.h Grammar from a DSL grammar.
+///Rule i is stored under key KeyT(i); references to rules invoke callbacks,
+///terminals are stored under keys starting at KeyT(rules.size()) and invoke
+///no callbacks. The DSL start rule is evaluated with g[KeyT(0)](is).
+///Link must be invoked on the grammar after the actions are defined.
+///Note: use a MemoTable with MemoPolicy::NONE to have pure PEG semantics,
+///with LAST memoization a call site re-evaluated at the same position
+///returns the recorded result without consuming input.
+template < typename GrammarT >
+class PegGrammarBuilder {
+public:
+    PegGrammarBuilder(const PegGrammar& pg, GrammarT& g)
+        : pg_(pg), g_(g), terminals_(pg.rules.size()) {}
+    void Build() {
+        for(std::size_t i = 0; i != pg_.rules.size(); ++i)
+            g_[i] = Build(pg_.rules[i].expr);
+    }
+private:
+    EvalFun Build(const PegExpr& e) {
+        switch(e.type) {
+        case PegExpr::LITERAL:
+            return g_.Term(terminals_++, PegLiteralParser(e.text), false);
+        case PegExpr::CLASS:
+            return g_.Term(terminals_++, PegClassParser(e.chars), false);
+        case PegExpr::ANY:
+            return g_.Term(terminals_++,
+                           PegClassParser(std::bitset< 256 >().set()), false);
+        case PegExpr::RULE:
+            return g_.CBCall(e.rule);
+        case PegExpr::SEQUENCE: {
+            Sequence s;
+            for(auto& c: e.children) s.children.push_back(Build(c));
+            return s;
+        }
+        case PegExpr::CHOICE: {
+            Choice c;
+            for(auto& a: e.children) c.children.push_back(Build(a));
+            return c;
+        }
+        case PegExpr::ZERO_OR_MORE:
+            return ZM(Build(e.children.front()));
+        case PegExpr::ONE_OR_MORE:
+            return OM(Build(e.children.front()));
+        case PegExpr::OPTIONAL:
+            //standard PEG optional: e / empty sequence
+            return OR(Build(e.children.front()), AND());
+        }
+        return EvalFun();
+    }
+    const PegGrammar& pg_;
+    GrammarT& g_;
+    std::size_t terminals_;
+};
+
+///Defines the rules of grammar g from DSL grammar pg, see PegGrammarBuilder.
+template < typename GrammarT >
+void BuildGrammar(const PegGrammar& pg, GrammarT& g) {
+    PegGrammarBuilder< GrammarT >(pg, g).Build();
+}
+
+//------------------------------------------------------------------------------
+//Code generation
+
+///Generates a header with a recursive descent parser for a DSL grammar:
+///one member function per rule and per compound expression, literals and
+///character classes inlined, choices dispatched through a switch on the
+///first character when the first characters of the alternatives are known;
+///no std::function or virtual calls.
+///The generated parser has the same semantics as the grammar built by
+///BuildGrammar with no memoization: the handler is invoked with the rule
+///index and matched range each time a referenced rule matches and its
+///return value replaces the result, as for PASS events of Grammar actions.
+///@code
+///namespace NS {
+///enum Rule { R_rule1, ... };
+///const char* RuleName(Rule);
+///template < typename HandlerT > //bool (Rule, const char*, const char*)
+///class Parser {
+///public:
+///    Parser(HandlerT& h);
+///    bool Parse(const char* begin, const char* end);
+///    std::size_t Pos() const; //number of consumed characters
+///};
+///}
+///@endcode
+class PegGenerator {
+public:
+    PegGenerator(const PegGrammar& g) : g_(g) {}
+    void Generate(std::ostream& os, const std::string& ns,
+                  const std::string& source = std::string()) {
+        fun_ = 0;
+        defs_.str("");
+        nullable_.assign(g_.rules.size(), UNKNOWN);
+        os << "//Generated by peggen";
+        if(!source.empty()) os << " from " << source;
+        os << ": do not edit\n"
+           << "#pragma once\n#include <cstddef>\n#include <cstring>\n\n"
+           << "namespace " << ns << " {\n\n"
+           << "enum Rule {";
+        for(std::size_t i = 0; i != g_.rules.size(); ++i)
+            os << (i ? ", " : "") << "R_" << g_.rules[i].name;
+        os << "};\n\n"
+           << "inline const char* RuleName(Rule r) {\n"
+           << "    static const char* names[] = {";
+        for(std::size_t i = 0; i != g_.rules.size(); ++i)
+            os << (i ? ", " : "") << '"' << g_.rules[i].name << '"';
+        os << "};\n    return names[r];\n}\n\n";
+        std::ostringstream rules;
+        for(std::size_t i = 0; i != g_.rules.size(); ++i) {
+            const std::string body = Expr(g_.rules[i].expr);
+            rules << "    //" << g_.rules[i].name << "\n"
+                  << "    bool b_" << g_.rules[i].name << "() {\n"
+                  << "        return " << body << ";\n    }\n"
+                  << "    bool r_" << g_.rules[i].name << "() {\n"
+                  << "        const char* b = cur_;\n"
+                  << "        if(!b_" << g_.rules[i].name
+                  << "()) return false;\n"
+                  << "        return h_(R_" << g_.rules[i].name
+                  << ", b, cur_);\n    }\n";
+        }
+        os << "template < typename HandlerT >\nclass Parser {\npublic:\n"
+           << "    Parser(HandlerT& h) : h_(h), begin_(0), cur_(0), end_(0) {}\n"
+           << "    bool Parse(const char* begin, const char* end) {\n"
+           << "        begin_ = cur_ = begin;\n        end_ = end;\n"
+           << "        return b_" << g_.rules.front().name << "();\n    }\n"
+           << "    std::size_t Pos() const { return cur_ - begin_; }\n"
+           << "private:\n"
+           << "    int Peek() const {\n"
+           << "        return cur_ != end_ ? int((unsigned char)*cur_) : 256;\n"
+           << "    }\n"
+           << "    bool Ch(char c) {\n"
+           << "        if(cur_ == end_ || *cur_ != c) return false;\n"
+           << "        ++cur_;\n        return true;\n    }\n"
+           << "    bool Lit(const char* s, std::size_t n) {\n"
+           << "        if(std::size_t(end_ - cur_) < n"
+           << " || std::memcmp(cur_, s, n)) return false;\n"
+           << "        cur_ += n;\n        return true;\n    }\n"
+           << "    bool Any() {\n"
+           << "        if(cur_ == end_) return false;\n"
+           << "        ++cur_;\n        return true;\n    }\n"
+           << rules.str() << defs_.str()
+           << "    HandlerT& h_;\n    const char* begin_;\n"
+           << "    const char* cur_;\n    const char* end_;\n};\n\n"
+           << "}\n";
+    }
+private:
+    enum Tri {NO, YES, UNKNOWN};
+    ///First character set; known == false if any character or end of input
+    ///may start a match or if the expression is nullable.
+    struct First {
+        bool known;
+        std::bitset< 256 > chars;
+    };
+    static std::string CharLiteral(unsigned char c) {
+        std::ostringstream os;
+        if(c == '\'' || c == '\\') os << "'\\" << c << "'";
+        else if(c >= 32 && c < 127) os << "'" << c << "'";
+        else os << "char(" << unsigned(c) << ")";
+        return os.str();
+    }
+    static std::string StringLiteral(const std::string& s) {
+        std::ostringstream os;
+        os << '"';
+        for(unsigned char c: s) {
+            if(c == '"' || c == '\\') os << '\\' << c;
+            else if(c >= 32 && c < 127) os << c;
+            else {
+                //octal escapes are at most three digits long
+                os << '\\' << char('0' + (c >> 6)) << char('0' + ((c >> 3) & 7))
+                   << char('0' + (c & 7));
+            }
+        }
+        os << '"';
+        return os.str();
+    }
+    ///Returns condition on int c matching character set, as ranges.
+    static std::string SetCondition(const std::bitset< 256 >& s) {
+        std::ostringstream os;
+        bool first = true;
+        for(unsigned i = 0; i != 256; ++i) {
+            if(!s.test(i)) continue;
+            unsigned j = i;
+            while(j + 1 != 256 && s.test(j + 1)) ++j;
+            os << (first ? "" : " || ");
+            if(i == j) os << "c == " << i;
+            else os << "(c >= " << i << " && c <= " << j << ")";
+            first = false;
+            i = j;
+        }
+        return first ? std::string("false") : os.str();
+    }
+    bool Nullable(const PegExpr& e) {
+        switch(e.type) {
+        case PegExpr::LITERAL: case PegExpr::CLASS: case PegExpr::ANY:
+            return false;
+        case PegExpr::RULE: {
+            Tri& n = nullable_[e.rule];
+            if(n == UNKNOWN) {
+                n = YES; //recursion: assume nullable
+                n = Nullable(g_.rules[e.rule].expr) ? YES : NO;
+            }
+            return n == YES;
+        }
+        case PegExpr::SEQUENCE:
+            for(auto& c: e.children) if(!Nullable(c)) return false;
+            return true;
+        case PegExpr::CHOICE:
+            for(auto& c: e.children) if(Nullable(c)) return true;
+            return false;
+        case PegExpr::ONE_OR_MORE:
+            return Nullable(e.children.front());
+        default:
+            return true;
+        }
+    }
+    ///First characters; an expression whose first characters are known
+    ///fails without consuming input if the next character is not in the set.
+    First FirstChars(const PegExpr& e, std::vector< bool >& visiting) {
+        First f = {false, std::bitset< 256 >()};
+        switch(e.type) {
+        case PegExpr::LITERAL:
+            f.known = true;
+            f.chars.set((unsigned char)e.text[0]);
+            break;
+        case PegExpr::CLASS:
+            f.known = true;
+            f.chars = e.chars;
+            break;
+        case PegExpr::ANY:
+            f.known = true;
+            f.chars.set();
+            break;
+        case PegExpr::RULE:
+            if(visiting[e.rule]) break;
+            visiting[e.rule] = true;
+            f = FirstChars(g_.rules[e.rule].expr, visiting);
+            visiting[e.rule] = false;
+            break;
+        case PegExpr::SEQUENCE:
+            if(!e.children.empty() && !Nullable(e.children.front()))
+                f = FirstChars(e.children.front(), visiting);
+            break;
+        case PegExpr::CHOICE:
+            f.known = true;
+            for(auto& c: e.children) {
+                const First cf = FirstChars(c, visiting);
+                if(!cf.known) return First{false, std::bitset< 256 >()};
+                f.chars |= cf.chars;
+            }
+            break;
+        case PegExpr::ONE_OR_MORE:
+            f = FirstChars(e.children.front(), visiting);
+            break;
+        default:
+            break;
+        }
+        return f;
+    }
+    First FirstChars(const PegExpr& e) {
+        std::vector< bool > visiting(g_.rules.size(), false);
+        return FirstChars(e, visiting);
+    }
+    ///Adds member function and returns call expression.
+    std::string Function(const std::string& body) {
+        std::ostringstream name;
+        name << "e" << fun_++;
+        defs_ << "    bool " << name.str() << "() {\n" << body << "    }\n";
+        return name.str() + "()";
+    }
+    ///Returns C++ expression evaluating e.
+    std::string Expr(const PegExpr& e) {
+        std::ostringstream b;
+        switch(e.type) {
+        case PegExpr::LITERAL:
+            if(e.text.size() == 1) return "Ch(" + CharLiteral(e.text[0]) + ")";
+            b << "Lit(" << StringLiteral(e.text) << ", " << e.text.size()
+              << ")";
+            return b.str();
+        case PegExpr::ANY:
+            return "Any()";
+        case PegExpr::CLASS:
+            b << "        const int c = Peek();\n"
+              << "        if(!(" << SetCondition(e.chars) << ")) return false;\n"
+              << "        ++cur_;\n        return true;\n";
+            return Function(b.str());
+        case PegExpr::RULE:
+            return "r_" + g_.rules[e.rule].name + "()";
+        case PegExpr::SEQUENCE: {
+            if(e.children.empty()) return "true";
+            std::vector< std::string > c;
+            for(auto& x: e.children) c.push_back(Expr(x));
+            b << "        const char* s = cur_;\n        if(";
+            for(std::size_t i = 0; i != c.size(); ++i)
+                b << (i ? "\n           && " : "") << c[i];
+            b << ") return true;\n        cur_ = s;\n        return false;\n";
+            return Function(b.str());
+        }
+        case PegExpr::CHOICE:
+            return Function(ChoiceBody(e));
+        case PegExpr::ZERO_OR_MORE:
+            b << "        while(" << Expr(e.children.front()) << ");\n"
+              << "        return true;\n";
+            return Function(b.str());
+        case PegExpr::ONE_OR_MORE: {
+            const std::string c = Expr(e.children.front());
+            b << "        if(!" << c << ") return false;\n"
+              << "        while(" << c << ");\n        return true;\n";
+            return Function(b.str());
+        }
+        case PegExpr::OPTIONAL:
+            b << "        " << Expr(e.children.front()) << ";\n"
+              << "        return true;\n";
+            return Function(b.str());
+        }
+        return "false";
+    }
+    ///Ordered choice; alternatives that cannot match the next character are
+    ///skipped through a switch on the first character.
+    std::string ChoiceBody(const PegExpr& e) {
+        std::vector< std::string > alts;
+        std::vector< First > firsts;
+        bool anyKnown = false;
+        for(auto& a: e.children) {
+            alts.push_back(Expr(a));
+            firsts.push_back(FirstChars(a));
+            anyKnown = anyKnown || firsts.back().known;
+        }
+        std::ostringstream b;
+        if(!anyKnown) {
+            b << "        return ";
+            for(std::size_t i = 0; i != alts.size(); ++i)
+                b << (i ? "\n            || " : "") << alts[i];
+            b << ";\n";
+            return b.str();
+        }
+        //group characters by the list of candidate alternatives; the
+        //alternatives with unknown first characters are the default case
+        std::map< std::vector< bool >, std::vector< unsigned > > groups;
+        std::vector< bool > def(alts.size());
+        for(std::size_t i = 0; i != alts.size(); ++i) def[i] = !firsts[i].known;
+        for(unsigned c = 0; c != 256; ++c) {
+            std::vector< bool > g(alts.size());
+            for(std::size_t i = 0; i != alts.size(); ++i)
+                g[i] = !firsts[i].known || firsts[i].chars.test(c);
+            if(g != def) groups[g].push_back(c);
+        }
+        auto Alternatives = [&alts](const std::vector< bool >& g) {
+            std::ostringstream os;
+            bool first = true;
+            for(std::size_t i = 0; i != alts.size(); ++i) {
+                if(!g[i]) continue;
+                os << (first ? "" : "\n                || ") << alts[i];
+                first = false;
+            }
+            return first ? std::string("false") : os.str();
+        };
+        b << "        switch(Peek()) {\n";
+        for(auto& g: groups) {
+            for(std::size_t i = 0; i != g.second.size(); ++i)
+                b << (i % 8 ? " " : (i ? "\n        " : "        "))
+                  << "case " << g.second[i] << ":";
+            b << "\n            return " << Alternatives(g.first) << ";\n";
+        }
+        b << "        default:\n            return " << Alternatives(def)
+          << ";\n        }\n";
+        return b.str();
+    }
+    const PegGrammar& g_;
+    std::vector< Tri > nullable_;
+    std::ostringstream defs_;
+    int fun_;
+};
+
+///Writes C++ parser for DSL grammar pg into os, see PegGenerator.
+inline void GeneratePegParser(const PegGrammar& pg, std::ostream& os,
+                              const std::string& ns,
+                              const std::string& source = std::string()) {
+    PegGenerator(pg).Generate(os, ns, source);
+}
+
+}
@@ -0,0 +1,493 @@
+#pragma once
+//Bytecode compiler and interpreter for peg.h grammars
+
+#include <vector>
+#include <map>
+#include "peg.h"
+#include "parsers.h"
+
+namespace parsley {
+
+///Compiles the rules of a linked Grammar into a flat instruction array and
+///evaluates them with an interpreter loop, in place of the std::function
+///graph built by the peg.h combinators.
+///Sequence, Choice, ZeroOrMore, OneOrMore, ZeroOrOne nodes and references to
+///rules and terminals of the same grammar are lowered to bytecode; any other
+///function (NOT, CUT, user defined functions, references to rules of other
+///grammars) is invoked through an opaque call instruction.
+///Constant string terminals (ConstStringParser) and character class
+///terminals (FirstAlphaNumParser, SequenceParser with a CharClassValidator)
+///are matched inline by LITERAL and CLASS instructions, with the same
+///semantics as the replaced parsers except that FirstAlphaNumParser tests
+///ASCII letters and digits independently of the current locale; other
+///terminal parsers are copied into the program and parse the input directly.
+///Actions, event masks and memoization of the source grammar are honoured;
+///the LAST memoization state is recorded per call site as in the closure
+///implementation, in a separate table owned by the program, and is
+///discarded by Grammar::Reset.
+///The grammar must outlive the program and must not be modified after
+///the program is compiled.
+///@code
+///Grammar< TERM, ActionMap, Ctx > g(am, ctx);
+///GenerateParser(g);
+///GrammarVM< TERM, ActionMap, Ctx > vm(g);
+///vm.Run(START, is);
+///@endcode
+template < typename KeyT, typename ActionMapT, typename ContextT >
+class GrammarVM {
+public:
+    using GrammarType = Grammar< KeyT, ActionMapT, ContextT >;
+    ///Operation codes.
+    enum OpCode : unsigned char {
+        HALT,   //end of program
+        CALL,   //evaluate rule or terminal at call site a
+        LITERAL,//match constant string terminal at call site a
+        CLASS,  //match character class terminal at call site a
+        SUB,    //evaluate subroutine at a
+        RET,    //end of rule body or subroutine
+        JMP,    //jump to a
+        JT,     //jump to a if result is true
+        JF,     //jump to a if result is false
+        JCUT,   //jump to a if a cut failed
+        JEND,   //jump to a if at end of input or stream not good
+        MARK,   //push stream checkpoint
+        UNMARK, //pop checkpoint, rewind to it if result is false
+        SETOK,  //set result to a != 0
+        NOTOK,  //negate result
+        CUTOK,  //set result to true if no cut failed
+        ANDCUT, //set result to false if a cut failed
+        OPAQUE  //invoke function a
+    };
+    ///Instruction.
+    struct Instruction {
+        OpCode op;
+        int a;
+    };
+    using Code = std::vector< Instruction >;
+    ///Constructor: compiles all the rules in the grammar.
+    GrammarVM(GrammarType& g) : g_(g) { Compile(); }
+    GrammarVM(const GrammarVM&) = delete;
+    GrammarVM& operator=(const GrammarVM&) = delete;
+    ///Evaluates the body of rule k, same as invoking g[k](is).
+    bool Run(KeyT k, InStream& is) {
+        auto i = g_.index_.find(k);
+        if(i == g_.index_.end()) return false;
+        return Execute(ruleStart_[i->second], is);
+    }
+    ///Returns compiled code.
+    const Code& GetCode() const { return code_; }
+    ///Returns number of functions invoked through OPAQUE instructions.
+    std::size_t OpaqueCount() const { return opaque_.size(); }
+private:
+    using Rule = typename GrammarType::Rule;
+    using RuleCall = typename GrammarType::RuleCall;
+    using TermCall = typename GrammarType::TermCall;
+    ///Call site: referenced rule, terminal parser index or -1, lowered
+    ///terminal index or -1, last evaluated position and result and grammar
+    ///generation in which they were recorded.
+    struct Site {
+        std::size_t rule;
+        bool cback;
+        int parser;
+        int term;
+        StreamOff sp;
+        bool last;
+        unsigned gen;
+    };
+    ///Terminal matched inline: constant string for LITERAL, first and
+    ///following character classes for CLASS; if @c strict is set the first
+    ///character is read unconditionally and put back on mismatch and the
+    ///value is reported even if empty, as in FirstAlphaNumParser.
+    struct Terminal {
+        ValueID name;
+        String text;
+        bool ignoreCase;
+        CharClass first;
+        CharClass rest;
+        bool strict;
+    };
+    ///Rule or subroutine activation record; site is -1 for subroutines.
+    struct Frame {
+        int ret;
+        int site;
+        StreamOff pos;
+        unsigned events;
+        MemoPolicy policy;
+    };
+    void Compile() {
+        code_.push_back({HALT, 0});
+        ruleStart_.resize(g_.Size());
+        for(std::size_t i = 0; i != g_.Size(); ++i) {
+            ruleStart_[i] = int(code_.size());
+            Emit(g_.rules_[i].eval);
+            code_.push_back({RET, 0});
+        }
+    }
+    int Here() const { return int(code_.size()); }
+    int Emit(OpCode op, int a = 0) {
+        code_.push_back({op, a});
+        return Here() - 1;
+    }
+    void Patch(const std::vector< int >& jumps) {
+        for(auto j: jumps) code_[j].a = Here();
+    }
+    ///Returns call site index; one site per function object, the same
+    ///object referenced twice shares memoization state.
+    template < typename CallT >
+    int SiteIndex(const CallT* c, int parser, int term = -1) {
+        auto i = sites_.find(c);
+        if(i != sites_.end()) return i->second;
+        site_.push_back({c->i, c->cback, parser, term, -1, false, 0});
+        sites_[c] = int(site_.size()) - 1;
+        return int(site_.size()) - 1;
+    }
+    void Emit(const EvalFun& f) {
+        if(const Sequence* s = f.target< Sequence >()) {
+            Emit(MARK);
+            if(s->children.empty()) Emit(SETOK, 1);
+            std::vector< int > fail;
+            for(std::size_t i = 0; i != s->children.size(); ++i) {
+                Emit(s->children[i]);
+                if(i + 1 != s->children.size()) fail.push_back(Emit(JF));
+            }
+            Patch(fail);
+            Emit(UNMARK);
+        } else if(const Choice* c = f.target< Choice >()) {
+            if(c->children.empty()) Emit(SETOK, 0);
+            std::vector< int > done;
+            for(std::size_t i = 0; i != c->children.size(); ++i) {
+                Emit(c->children[i]);
+                if(i + 1 != c->children.size()) {
+                    done.push_back(Emit(JT));
+                    done.push_back(Emit(JCUT));
+                }
+            }
+            Patch(done);
+        } else if(const ZeroOrMore* z = f.target< ZeroOrMore >()) {
+            EmitLoop([this, z]() { Emit(z->f); });
+        } else if(const OneOrMore* o = f.target< OneOrMore >()) {
+            const int body = EmitSubroutine(o->f);
+            Emit(SUB, body);
+            const int fail = Emit(JF);
+            EmitLoop([this, body]() { Emit(SUB, body); });
+            Patch({fail});
+        } else if(const ZeroOrOne* z = f.target< ZeroOrOne >()) {
+            const int body = EmitSubroutine(z->f);
+            Emit(SUB, body);
+            const int zero = Emit(JF);
+            Emit(SUB, body);
+            Emit(NOTOK);
+            const int check = Emit(JMP);
+            Patch({zero});
+            Emit(SETOK, 1);
+            Patch({check});
+            Emit(ANDCUT);
+        } else if(const RuleCall* r = f.target< RuleCall >()) {
+            if(r->g == &g_) Emit(CALL, SiteIndex(r, -1));
+            else EmitOpaque(f);
+        } else if(const TermCall* t = f.target< TermCall >()) {
+            if(t->g != &g_) {
+                EmitOpaque(f);
+                return;
+            }
+            if(sites_.find(t) != sites_.end()) {
+                const int i = sites_[t];
+                Emit(site_[i].term < 0 ? CALL
+                     : terms_[site_[i].term].text.empty() ? CLASS : LITERAL,
+                     i);
+                return;
+            }
+            Terminal term;
+            if(Lower(t->p, term)) {
+                terms_.push_back(term);
+                Emit(term.text.empty() ? CLASS : LITERAL,
+                     SiteIndex(t, -1, int(terms_.size()) - 1));
+                return;
+            }
+            parsers_.push_back(t->p);
+            Emit(CALL, SiteIndex(t, int(parsers_.size()) - 1));
+        } else EmitOpaque(f);
+    }
+    ///Returns descriptor of terminal to match inline, false if parser
+    ///has to be invoked.
+    static bool Lower(const Parser& parser, Terminal& t) {
+        const IParser* p = parser.Get();
+        while(const Parser* w = dynamic_cast< const Parser* >(p)) p = w->Get();
+        if(auto c = dynamic_cast< const ConstStringParser* >(p)) {
+            if(c->GetString().empty()) return false;
+            t = {c->GetName(), c->GetString(), c->IgnoreCase(),
+                 CharClass(), CharClass(), false};
+        } else if(auto f = dynamic_cast< const FirstAlphaNumParser* >(p)) {
+            t = {f->GetName(), String(), false,
+                 AlphaChars::Value(), AlnumChars::Value(), true};
+        } else if(auto i = dynamic_cast<
+                    const SequenceParser< IdentifierValidator >* >(p)) {
+            t = {i->GetName(), String(), false,
+                 AlphaChars::Value(), AlnumChars::Value(), false};
+        } else if(auto a = dynamic_cast<
+                    const SequenceParser< AlnumClassValidator >* >(p)) {
+            t = {a->GetName(), String(), false,
+                 AlnumChars::Value(), AlnumChars::Value(), false};
+        } else return false;
+        return true;
+    }
+    ///Appends characters accepted by v(index, char) to token, same loop as
+    ///SequenceParser::Parse; returns true if any character was appended.
+    template < typename ValidatorT >
+    static bool Scan(InStream& is, String& token, ValidatorT v) {
+        const std::size_t n = token.size();
+        while(!is.eof() && is.good()) {
+            const Char c = is.get();
+            if(!is.good()) return token.size() > n;
+            if(!v(token.size() - n, c)) break;
+            token.push_back(c);
+        }
+        if(is.good() && !is.eof()) is.unget();
+        return token.size() > n;
+    }
+    ///LITERAL: same as ConstStringParser, a non empty prefix of the string
+    ///is a match.
+    bool MatchLiteral(const Terminal& t, InStream& is) {
+        token_.clear();
+        if(!is.good()) return false;
+        const String& s = t.text;
+        if(t.ignoreCase) {
+            return Scan(is, token_, [&s](std::size_t i, Char c) {
+                return i < s.size() && ToLower(s[i]) == ToLower(c);
+            });
+        }
+        return Scan(is, token_, [&s](std::size_t i, Char c) {
+            return i < s.size() && s[i] == c;
+        });
+    }
+    ///CLASS: same as FirstAlphaNumParser if strict is set, as SequenceParser
+    ///with a CharClassValidator otherwise.
+    bool MatchClass(const Terminal& t, InStream& is) {
+        token_.clear();
+        if(!is.good()) return false;
+        const CharClass& rest = t.rest;
+        auto next = [&rest](std::size_t, Char c) { return rest.Test(c); };
+        if(t.strict) {
+            const Char c = is.get();
+            if(!t.first.Test(c)) {
+                is.unget();
+                return false;
+            }
+            token_.push_back(c);
+            Scan(is, token_, next);
+            return true;
+        }
+        const CharClass& first = t.first;
+        return Scan(is, token_, [&first, &rest](std::size_t i, Char c) {
+            return i ? rest.Test(c) : first.Test(c);
+        });
+    }
+    ///Returns values reported by terminal after the last match.
+    const Values& TermValues(const Terminal& t) {
+        values_.clear();
+        if(t.strict || !token_.empty()) {
+            values_.insert(std::make_pair(t.name, token_));
+        }
+        return values_;
+    }
+    ///Emits function as a subroutine ending with RET, jumped over by
+    ///the enclosing code; returns the subroutine address.
+    ///Used by nodes evaluating their child more than once, so that the
+    ///child code is emitted once and program size is linear in the
+    ///nesting depth.
+    int EmitSubroutine(const EvalFun& f) {
+        const int skip = Emit(JMP);
+        const int body = Here();
+        Emit(f);
+        Emit(RET);
+        Patch({skip});
+        return body;
+    }
+    ///Zero or more: loop until failure or end of input; body() emits the
+    ///code evaluating the repeated function.
+    template < typename F >
+    void EmitLoop(const F& body) {
+        const int loop = Here();
+        const int end = Emit(JEND);
+        body();
+        Emit(JT, loop);
+        Patch({end});
+        Emit(CUTOK);
+    }
+    void EmitOpaque(const EvalFun& f) {
+        const void* key = &f;
+        auto i = opaqueIndex_.find(key);
+        if(i == opaqueIndex_.end()) {
+            opaque_.push_back(f);
+            i = opaqueIndex_.insert(
+                    std::make_pair(key, int(opaque_.size()) - 1)).first;
+        }
+        Emit(OPAQUE, i->second);
+    }
+    ///Dispatches PASS or FAIL event and records result, same as the
+    ///second half of Grammar::Eval.
+    void Complete(Site& s, unsigned events, MemoPolicy policy,
+                  StreamOff pos, bool& ok, InStream& is) {
+        Rule& r = g_.rules_[s.rule];
+        if(events & (ok ? PASS_EVENT : FAIL_EVENT)) {
+            const EvalState es = ok ? EvalState::PASS : EvalState::FAIL;
+            const Values& v = s.term >= 0 ? TermValues(terms_[s.term])
+                              : s.parser >= 0 ? parsers_[s.parser].GetValues()
+                                              : GrammarType::NoValues();
+            ok = r.action(r.key, v, *g_.ctx_, es) && ok;
+        }
+        s.sp = pos;
+        s.last = ok;
+        s.gen = g_.generation_;
+        if(policy == MemoPolicy::FULL && pos >= 0) {
+            const StreamOff end = is.tellg();
+            if(end >= 0) g_.memo_->Insert(r.key, pos, ok, end);
+        }
+    }
+    bool Execute(int pc, InStream& is) {
+        frames_.clear();
+        frames_.push_back({0, -1, 0, unsigned(NO_EVENTS), MemoPolicy::NONE});
+        bool ok = false;
+        const Instruction* code = code_.data();
+        for(;;) {
+            const Instruction& in = code[pc];
+            switch(in.op) {
+            case HALT:
+                return ok;
+            case CALL:
+            case LITERAL:
+            case CLASS: {
+                Site& s = site_[in.a];
+                Rule& r = g_.rules_[s.rule];
+                const MemoPolicy policy = g_.memo_
+                                          ? g_.memo_->GetPolicy(r.key)
+                                          : MemoPolicy::LAST;
+                const StreamOff pos = is.tellg();
+                ++pc;
+                if(policy == MemoPolicy::FULL && pos >= 0) {
+                    if(auto e = g_.memo_->Find(r.key, pos)) {
+                        is.seekg(e->end);
+                        ok = e->pass;
+                        break;
+                    }
+                }
+                if(policy == MemoPolicy::LAST && pos == s.sp
+                   && s.gen == g_.generation_) {
+                    ok = s.last;
+                    break;
+                }
+                const unsigned events = s.cback ? r.events
+                                                : unsigned(NO_EVENTS);
+                ok = true;
+                if(events & BEGIN_EVENT) {
+                    ok = r.action(r.key, GrammarType::NoValues(), *g_.ctx_,
+                                  EvalState::BEGIN);
+                }
+                if(in.op == LITERAL) {
+                    ok = ok && MatchLiteral(terms_[s.term], is);
+                    Complete(s, events, policy, pos, ok, is);
+                } else if(in.op == CLASS) {
+                    ok = ok && MatchClass(terms_[s.term], is);
+                    Complete(s, events, policy, pos, ok, is);
+                } else if(s.parser >= 0) {
+                    ok = ok && parsers_[s.parser].Parse(is);
+                    Complete(s, events, policy, pos, ok, is);
+                } else if(!ok) {
+                    Complete(s, events, policy, pos, ok, is);
+                } else {
+                    frames_.push_back({pc, in.a, pos, events, policy});
+                    pc = ruleStart_[s.rule];
+                }
+                break;
+            }
+            case SUB:
+                frames_.push_back({pc + 1, -1, 0, unsigned(NO_EVENTS),
+                                   MemoPolicy::NONE});
+                pc = in.a;
+                break;
+            case RET: {
+                const Frame f = frames_.back();
+                frames_.pop_back();
+                if(f.site >= 0) {
+                    Complete(site_[f.site], f.events, f.policy, f.pos, ok,
+                             is);
+                }
+                pc = f.ret;
+                break;
+            }
+            case JMP:
+                pc = in.a;
+                break;
+            case JT:
+                pc = ok ? in.a : pc + 1;
+                break;
+            case JF:
+                pc = ok ? pc + 1 : in.a;
+                break;
+            case JCUT:
+                pc = is.cut_failed() ? in.a : pc + 1;
+                break;
+            case JEND:
+                pc = is.eof() || !is.good() ? in.a : pc + 1;
+                break;
+            case MARK:
+                marks_.push_back(is.mark());
+                ++pc;
+                break;
+            case UNMARK:
+                if(!ok) is.reset(marks_.back());
+                is.release(marks_.back());
+                marks_.pop_back();
+                ++pc;
+                break;
+            case SETOK:
+                ok = in.a != 0;
+                ++pc;
+                break;
+            case NOTOK:
+                ok = !ok;
+                ++pc;
+                break;
+            case CUTOK:
+                ok = !is.cut_failed();
+                ++pc;
+                break;
+            case ANDCUT:
+                ok = ok && !is.cut_failed();
+                ++pc;
+                break;
+            case OPAQUE:
+                ok = opaque_[in.a](is);
+                ++pc;
+                break;
+            }
+        }
+    }
+    GrammarType& g_;
+    ///Instructions; index zero holds HALT, used as return address of the
+    ///outermost frame.
+    Code code_;
+    ///Index of first instruction of each rule.
+    std::vector< int > ruleStart_;
+    ///Call sites.
+    std::vector< Site > site_;
+    ///Function object to call site map, used at compile time only.
+    std::map< const void*, int > sites_;
+    ///Terminal parsers.
+    std::vector< Parser > parsers_;
+    ///Terminals matched inline.
+    std::vector< Terminal > terms_;
+    ///Text matched by the last LITERAL or CLASS instruction.
+    String token_;
+    ///Values reported to actions by LITERAL and CLASS call sites.
+    Values values_;
+    ///Functions invoked through OPAQUE.
+    std::vector< EvalFun > opaque_;
+    std::map< const void*, int > opaqueIndex_;
+    ///Rule activation records.
+    std::vector< Frame > frames_;
+    ///Stream checkpoints pushed by sequences.
+    std::vector< typename InStream::Mark > marks_;
+};
+
+}
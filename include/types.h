@@ -37,6 +37,7 @@
 #include <cctype>
 #include <map>
 #include <vector>
+#include <set>
 #include "InStream.h"
 #include "Any.h"
 
@@ -49,6 +50,8 @@ typedef InStream::streamoff StreamOff;
 typedef InStream::char_type Char;
 typedef String ValueID;
 typedef String ParserID;
+/// Set of value identifiers, used to select the values to extract.
+typedef std::set< ValueID > ValueIDs;
 //@todo consider using an unordered_map or making it configurable
 typedef std::map< ValueID, Any > Values;
 template < typename MapT >
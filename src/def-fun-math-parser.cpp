@@ -317,7 +317,7 @@ public:
     EvalFrame(EvalFrame&&) = default;
     EvalFrame& operator=(const EvalFrame&) = default;
     EvalFrame& operator=(EvalFrame&&) = default;
-    EvalFrame operator()(const Term& t, APPLY stage) {
+    EvalFrame& operator()(const Term& t, APPLY stage) {
         if(stage == APPLY::BEGIN) {
             switch(t.type) {
                 case NUMBER:
@@ -0,0 +1,120 @@
+//Benchmark: deferred evaluation of an expression built one term at a time
+//the same way the math-parser callbacks do, chain of nested closures vs
+//postfix instruction tape
+//Usage: deferred-eval-bench [number of evaluations] [number of terms]
+//The expression is x * 1 + y / 1 - x * 2 + y / 2 ...
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include <STProgram.h>
+
+using namespace std;
+
+namespace {
+//==============================================================================
+using namespace parsley;
+using real_t = double;
+
+///Builds closures through pattern:
+///    f = [f, fi]() { return f() + fi(); };
+///as in previous versions of math-parser HandleTerm3
+class ClosureBuilder {
+public:
+    using EvaluateFunction = std::function< real_t () >;
+    ClosureBuilder(const vector< real_t >& vars) : vars_(vars) {}
+    void Number(real_t r) { functions_.push_back([r]() { return r; }); }
+    void Var(size_t k) {
+        const vector< real_t >& vars = vars_;
+        functions_.push_back([&vars, k]() { return vars[k]; });
+    }
+    void Op(char op) {
+        EvaluateFunction f = functions_[functions_.size() - 2];
+        EvaluateFunction fi = functions_.back();
+        switch(op) {
+            case '+': f = [f, fi]() { return f() + fi(); }; break;
+            case '-': f = [f, fi]() { return f() - fi(); }; break;
+            case '*': f = [f, fi]() { return f() * fi(); }; break;
+            case '/': f = [f, fi]() { return f() / fi(); }; break;
+        }
+        functions_.pop_back();
+        functions_.back() = f;
+    }
+    real_t Run() const { return functions_.front()(); }
+private:
+    const vector< real_t >& vars_;
+    vector< EvaluateFunction > functions_;
+};
+
+///Appends instructions to postfix program, as math-parser HandleTerm3
+class TapeBuilder {
+public:
+    using Tape = Program< real_t >;
+    TapeBuilder(const vector< real_t >& vars) : vars_(vars) {}
+    void Number(real_t r) { tape_.Append(Tape::Push(r)); }
+    void Var(size_t k) { tape_.Append(Tape::Load(int(k))); }
+    void Op(char op) {
+        switch(op) {
+            case '+': tape_.Append(Tape::Arith(ARITH::ADD)); break;
+            case '-': tape_.Append(Tape::Arith(ARITH::SUB)); break;
+            case '*': tape_.Append(Tape::Arith(ARITH::MUL)); break;
+            case '/': tape_.Append(Tape::Arith(ARITH::DIV)); break;
+        }
+    }
+    real_t Run() { return tape_.Run(vars_.data()); }
+private:
+    const vector< real_t >& vars_;
+    Tape tape_;
+};
+
+///Generates expression in the order in which terms are parsed
+template < typename BuilderT >
+void Build(BuilderT& b, int terms) {
+    for(int i = 0; i != terms; ++i) {
+        b.Var(i % 2);
+        b.Number(i / 2 + 1);
+        b.Op(i % 2 ? '/' : '*');
+        if(i) b.Op(i % 4 == 3 ? '-' : '+');
+    }
+}
+
+using Clock = chrono::steady_clock;
+
+double Ms(Clock::time_point start) {
+    return chrono::duration< double, milli >(Clock::now() - start).count();
+}
+
+///Times building and repeated evaluation, returns sum of results
+template < typename BuilderT >
+real_t Time(const char* label, int evaluations, int terms) {
+    vector< real_t > vars(2);
+    auto start = Clock::now();
+    BuilderT b(vars);
+    Build(b, terms);
+    const double build = Ms(start);
+    start = Clock::now();
+    real_t sum = 0;
+    for(int i = 0; i != evaluations; ++i) {
+        vars[0] = i * 0.001;
+        vars[1] = 1 - i * 0.002;
+        sum += b.Run();
+    }
+    cout << label << ": build " << build << " ms, evaluation " << Ms(start)
+         << " ms, sum " << sum << endl;
+    return sum;
+}
+
+}
+
+///Entry point
+int main(int argc, char** argv) {
+    const int evaluations = argc > 1 ? atoi(argv[1]) : 1000000;
+    const int terms = argc > 2 ? atoi(argv[2]) : 16;
+    const real_t c = Time< ClosureBuilder >("closures", evaluations, terms);
+    const real_t t = Time< TapeBuilder >("tape    ", evaluations, terms);
+    return c == t ? 0 : 1;
+}
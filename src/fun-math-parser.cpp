@@ -7,12 +7,21 @@
 #include <functional>
 #include <cmath>
 #include <stack>
+#include <set>
 
 #include <peg.h>
+#ifdef PEG_VM
+#include <pegvm.h>
+#endif
 #include <unordered_map>
 #include <map>
 #include <InStream.h>
 #include <STree.h>
+#include <LRUCache.h>
+#include <SymbolTable.h>
+#ifdef PROGRAM_EVAL
+#include <STProgram.h>
+#endif
 #include <types.h>
 //following is required for parser composition: (P1,P2) -> P1 & P2 -> AndParser
 #include <parser_operators.h>
@@ -80,46 +89,54 @@ using AST = STree< Term, std::map< TERM, int > >;
 
 using Args = std::vector< real_t >;
 using F = std::function< real_t (const Args&) >;
-using FunLUT = std::unordered_map<real_t, F >;
-using VarLUT = std::unordered_map<real_t, real_t >;
-using Name2Key = std::unordered_map< std::string, real_t >;
+//functions and variables are stored at slot index, slots are assigned by
+//symbol tables at parse time
+using FunLUT = std::vector< F >;
+using VarLUT = std::vector< real_t >;
 using Op2Key = std::unordered_map< TERM, real_t, TERMHash >;
     
 //Context
 struct Ctx {
     AST ast;
     FunLUT fl = {
-        {0, [](const Args& args) {
+        //sum
+        [](const Args& args) {
             assert(args.size());
             real_t r = 0;
             for(auto i: args) r += i;
-            return r; }},
-        {1, [](const Args& args) {
+            return r; },
+        //sub
+        [](const Args& args) {
             assert(args.size());
             real_t r = -args.front();
             Args::const_iterator i = ++args.begin();
             for(;i != args.end(); ++i, r -= *i);
-            return r; }},
-        {2, [](const Args& args) {
+            return r; },
+        //mul
+        [](const Args& args) {
             assert(args.size() > 1);
             real_t r = 1;
             for(auto i: args) r *= i;
-            return r; }},
-        {3, [](const Args& args) {
+            return r; },
+        //div
+        [](const Args& args) {
             assert(args.size() > 1);
             real_t r = args.front();
             Args::const_iterator i = ++args.begin();
             for(;i != args.end(); ++i, r /= *i);
-            return r; }},
-        {4, [](const Args& args) {
+            return r; },
+        //sin
+        [](const Args& args) {
             assert(args.size());
             real_t r = sin(args.front());
-            return r; }},
-        {5, [](const Args& args) {
+            return r; },
+        //cos
+        [](const Args& args) {
             assert(args.size());
             real_t r = cos(args.front());
-            return r; }},
-        {6, [](const Args& args) {
+            return r; },
+        //pow
+        [](const Args& args) {
             assert(args.size() > 1);
             real_t b = args[0];
             real_t e = args[1];
@@ -127,16 +144,10 @@ struct Ctx {
             Args::const_iterator i = ++args.begin();
             ++i;
             for(;i != args.end(); ++i) r = pow(r, *i);
-            return r; }}
-    };
-    Name2Key fn = {
-        {"sin", 4},
-        {"cos", 5},
-        {"pow", 6},
-        {"sum", 0},
-        {"sub", 1},
-        {"mul", 2}
+            return r; }
     };
+    //function names, in the same order as the functions in array
+    SymbolTable fn = {"sum", "sub", "mul", "div", "sin", "cos", "pow"};
     Op2Key ops = {
         {PLUS, 0},
         {MINUS, 1},
@@ -144,16 +155,21 @@ struct Ctx {
         {DIV, 3},
         {POW, 6}
     };
-    Name2Key varkey;
+    SymbolTable varkey;
     VarLUT vl;
+    //weights of the nodes of the function calls being parsed, innermost
+    //last
+    std::vector< int > calls;
+    ///Returns slot of variable, variables with no value are initialized
+    ///with NaN
+    size_t Slot(const string& name) {
+        const size_t k = varkey.Add(name);
+        if(k >= vl.size())
+            vl.resize(k + 1, std::numeric_limits<real_t>::quiet_NaN());
+        return k;
+    }
 };
     
-    
-//generate new key used for variable->value mapping
-real_t GenKey() {
-    static real_t k = real_t(0);
-    return k++;
-}
 
 ///True if term is an operation
 bool Op(TERM t) {
@@ -164,10 +180,8 @@ bool Op(TERM t) {
     || t == POW;
 }
     
-//required customization points
-//not used in this case but required because of the methods of STree
-//used GetData to extract the return type at compile time
-real_t GetData(const Term& t) { return t.value; }
+//required customization points; GetData is not needed since the tree is
+//evaluated through ScopedApply, which passes whole terms to the visitor
 TERM GetType(const Term& t) { return t.type; }
 //scope is handled directly from the parsing callback function by
 //explicitly increasing decreasing weight offset
@@ -181,15 +195,7 @@ bool HandleTerm(TERM t, const Values& v, Ctx& ctx, EvalState es) {
     if(Op(t)) {
         ctx.ast.Add({t, ctx.ops[t]});
     } else if(t == VAR) {
-        if(In(Get(v), ctx.varkey)) {
-            const real_t k = Get(ctx.varkey, Get(v));
-            ctx.ast.Add({t, k});
-        } else {
-            const real_t k = GenKey();
-            ctx.varkey[Get(v)] = k;
-            ctx.vl[k] = std::numeric_limits<real_t>::quiet_NaN();
-            ctx.ast.Add({t, k});
-        }
+        ctx.ast.Add({t, real_t(ctx.Slot(Get(v)))});
     } else if(t == NUMBER) {
         ctx.ast.Add({t, Get(v)});
     } else if(t == OP) {
@@ -200,16 +206,23 @@ bool HandleTerm(TERM t, const Values& v, Ctx& ctx, EvalState es) {
         return true;
     //function evaluation
     } else if(t == FBEGIN) {
-        assert(In(v.find("name")->second, ctx.fn));
-        ctx.ast.Add({t, Get(ctx.fn, v.find("name")->second)});
+        const size_t k = ctx.fn.Find(v.find("name")->second);
+        assert(k != SymbolTable::NONE);
+        ctx.calls.push_back(weights[FBEGIN] + ctx.ast.GetOffset());
+        ctx.ast.Add({t, real_t(k)});
         ctx.ast.SaveOffset();
         ctx.ast.OffsetInc(OP);
         return true;
     } else if(t == FEND) {
         ctx.ast.ResetOffset();
+        ctx.calls.pop_back();
         return true;
     } else if(t == FSEP) {
-        ctx.ast.Rewind(FBEGIN);
+        //move back to the function node, next argument is added as its
+        //child; STree::Rewind adds the current offset within nested calls
+        assert(!ctx.calls.empty());
+        const int w = ctx.calls.back();
+        ctx.ast.Rewind(ctx.calls.size() > 1 ? w - ctx.ast.GetOffset() : w);
         return true;
     } else if(!v.empty()) {
         ctx.ast.Add({t, real_t()});
@@ -222,15 +235,14 @@ bool HandleTerm(TERM t, const Values& v, Ctx& ctx, EvalState es) {
 using ActionFun = std::function< bool (TERM, const Values&, Ctx&, EvalState) >;
     
 
-using ParsingRules = std::map< TERM, EvalFun >;
 using ActionMap = std::map< TERM, ActionFun  >;
+using ParsingRules = Grammar< TERM, ActionMap, Ctx >;
 
-///Generate parser table map: each element represent a parsing rule
-ParsingRules GenerateParser(ActionMap& am, Ctx& ctx) {
+///Generate parser table: each element represent a parsing rule
+void GenerateParser(ParsingRules& g) {
     
-    ParsingRules g; // grammar
-    auto n  = MAKE_CALL(TERM, g, am, ctx);
-    auto mt = MAKE_EVAL(TERM, g, am, ctx);
+    auto n  = [&g](TERM t) { return g.Call(t); };
+    auto mt = [&g](TERM t, Parser p) { return g.Term(t, p); };
     
     //grammar definition
     //non-terminal - note the top-down definition through deferred calls using
@@ -277,7 +289,7 @@ ParsingRules GenerateParser(ActionMap& am, Ctx& ctx) {
     g[FEND]   = mt(FEND, CS(")"));
     g[FSEP]   = mt(FSEP, CS(","));
     
-    return g;
+    g.Link();
 }
 
 
@@ -306,8 +318,8 @@ private:
     using ArgStack = std::stack< Args, vector< vector< real_t > > >;
     using Function = std::function< real_t (const Args&) >;
     using FunStack = std::stack< Function >;
-    using FunLUT = std::unordered_map< real_t, Function >;
-    using VarLUT = std::unordered_map< real_t, real_t >;
+    using FunLUT = std::vector< Function >;
+    using VarLUT = std::vector< real_t >;
     using FLUTRef = std::reference_wrapper< FunLUT >;
     using VLUTRef = std::reference_wrapper< VarLUT >;
 public:
@@ -316,7 +328,7 @@ public:
     EvalFrame(EvalFrame&&) = default;
     EvalFrame& operator=(const EvalFrame&) = default;
     EvalFrame& operator=(EvalFrame&&) = default;
-    EvalFrame operator()(const Term& t, APPLY stage) {
+    EvalFrame& operator()(const Term& t, APPLY stage) {
         if(stage == APPLY::BEGIN) {
             switch(t.type) {
                 case NUMBER:
@@ -325,18 +337,18 @@ public:
                 case ASSIGN:
                     args_.push(Args());
                     f_.push([this](const Args& args) {
+                        //first argument: slot of assigned variable
                         assert(args.size() > 1);
-                        vlut_.get()[args[args.size() - 2]] = args.back();
+                        const size_t slot = size_t(args.front());
+                        assert(slot < vlut_.get().size());
+                        vlut_.get()[slot] = args.back();
                         return args.back();
                     });
                     break;
                 case VAR:
-                    if(last_ == ASSIGN) {
-                        if(vlut_.get().find(t.value) != vlut_.get().end())
-                            args_.top().push_back(t.value);
-                        else args_.top().push_back(GenKey());
-                    }
-                    else args_.top().push_back(vlut_.get()[t.value]);
+                    //assigned variable: pass slot index
+                    if(last_ == ASSIGN) args_.top().push_back(t.value);
+                    else args_.top().push_back(vlut_.get()[size_t(t.value)]);
                     break;
                 default: {
                     //only do it for user defined function
@@ -345,7 +357,7 @@ public:
 //                    flut_ = flutstack_.top();
 //                    vlut_ = vlutstack_.top();
                     args_.push(Args());
-                    f_.push(flut_.get()[t.value]);
+                    f_.push(flut_.get()[size_t(t.value)]);
                 }
                 break;
             }
@@ -387,27 +399,108 @@ private:
 
     
 
-///Parse expression and return evaluated result
-real_t MathParser(const string& expr, Ctx& ctx) {
-    istringstream iss(expr);
-    InStream is(iss);//, [](Char c) {return c == ' ' || c == '\t';});
-    ctx.ast.SetWeights(weights);
-    ActionMap am;
-    auto HT = HandleTerm;
-    Set(am, HT, NUMBER,
-        EXPR, OP, CP, PLUS, MINUS, MUL, DIV, POW, SUM, PRODUCT, VALUE,
-        ASSIGN, ASSIGNMENT, VAR, FBEGIN, FEND, FSEP);
-    ParsingRules g = GenerateParser(am, ctx);
-    g[START](is);
-    
-    if(is.tellg() < expr.size()) {
-        cerr << "ERROR AT: " << is.tellg() << endl;
-        return std::numeric_limits< real_t >::quiet_NaN();
+///Expression parser: the grammar is generated once and reused for all the
+///expressions, the context is bound at each parse
+class ExprParser {
+public:
+    ExprParser() : g_(am_) {
+        auto HT = HandleTerm;
+        Set(am_, HT, NUMBER,
+            EXPR, OP, CP, PLUS, MINUS, MUL, DIV, POW, SUM, PRODUCT, VALUE,
+            ASSIGN, ASSIGNMENT, VAR, FBEGIN, FEND, FSEP);
+        //handlers only act on PASS: BEGIN and FAIL events are not dispatched
+        g_.SetEvents(PASS_EVENT);
+        GenerateParser(g_);
+#ifdef PEG_VM
+        vm_.reset(new GrammarVM< TERM, ActionMap, Ctx >(g_));
+#endif
+    }
+    ExprParser(const ExprParser&) = delete;
+    ExprParser& operator=(const ExprParser&) = delete;
+    ///Parse expression, returns false in case of parsing error
+    bool Parse(const string& expr, Ctx& ctx) {
+        istringstream iss(expr);
+        InStream is(iss);//, [](Char c) {return c == ' ' || c == '\t';});
+        ctx.ast.SetWeights(weights);
+        ctx.calls.clear();
+        g_.SetContext(ctx);
+        g_.Reset();
+#ifdef PEG_VM
+        vm_->Run(START, is);
+#else
+        g_[START](is);
+#endif
+        if(is.tellg() < expr.size()) {
+            cerr << "ERROR AT: " << is.tellg() << endl;
+            return false;
+        }
+        return true;
     }
+private:
+    ActionMap am_;
+    ParsingRules g_;
+#ifdef PEG_VM
+    std::unique_ptr< GrammarVM< TERM, ActionMap, Ctx > > vm_;
+#endif
+};
+
+#ifdef PROGRAM_EVAL
+using EvalProgram = Program< real_t, std::function< real_t (real_t, real_t) >,
+                             F >;
+
+///Returns true if syntax tree contains assignments
+bool Assigns(const AST& ast) {
+    bool assigns = false;
+    ast.Apply([&assigns](const Term& t) {
+        assigns = assigns || t.type == ASSIGN;
+    });
+    return assigns;
+}
+
+///Compiles syntax tree into postfix program replicating EvalFrame: values
+///are pushed at BEGIN, functions invoked at END with values of children;
+///variables are loaded from the slot array passed to Program::Run
+EvalProgram Compile(const AST& ast, const Ctx& ctx, const F& assign) {
+    //functions are pure, variables can be shared unless assigned
+    const bool assigns = Assigns(ast);
+    TERM last = TERM();
+    auto resolve = [&ctx, &assign, &last, assigns](const Term& t) {
+        EvalProgram::Instruction i;
+        switch(t.type) {
+            case NUMBER:
+                i = EvalProgram::Push(t.value);
+                break;
+            case ASSIGN:
+                i = EvalProgram::Call(&assign);
+                break;
+            case VAR:
+                if(last == ASSIGN) {
+                    i = EvalProgram::Push(t.value);
+                } else {
+                    i = EvalProgram::Load(int(t.value));
+                    i.pure = !assigns;
+                }
+                break;
+            default:
+                i = EvalProgram::Call(&ctx.fl[size_t(t.value)]);
+                i.pure = true;
+                break;
+        }
+        last = t.type;
+        return i;
+    };
+    auto p = CompileScopedApply< EvalProgram >(ast.GetTree(), resolve);
+    p.Optimize();
+    return p;
+}
+#endif
+
+///Evaluate syntax tree
+real_t Evaluate(const AST& ast, Ctx& ctx) {
 #ifdef PRINT_TREE
     int s = 0;
     cout << '\n';
-    ctx.ast.Apply([s](const Term& t) mutable {
+    ast.Apply([s](const Term& t) mutable {
         if(t.type != NUMBER) s += 2;
         else if(ScopeEnd(t)) s -= 2;
         assert(s >= 0);
@@ -415,23 +508,136 @@ real_t MathParser(const string& expr, Ctx& ctx) {
     });
 #endif
 
-    return ctx.ast.ScopedApply(EvalFrame(ctx.fl, ctx.vl)).Result();
+#ifdef PROGRAM_EVAL
+    const F assign = [&ctx](const Args& args) {
+        //first argument: slot of assigned variable
+        assert(args.size() > 1);
+        const size_t slot = size_t(args.front());
+        assert(slot < ctx.vl.size());
+        ctx.vl[slot] = args.back();
+        return args.back();
+    };
+    return Compile(ast, ctx, assign).Run(ctx.vl.data());
+#else
+    return ast.ScopedApply(EvalFrame(ctx.fl, ctx.vl)).Result();
+#endif
 }
 
+///Parsed expression: syntax tree and slots of the variables it references
+struct Expression {
+    AST ast;
+    std::vector< std::pair< string, size_t > > vars;
+};
+
+///Parsed expressions keyed by expression text
+using ExprCache = LRUCache< string, Expression >;
+
+///Removes leading and trailing blanks
+string Normalize(const string& expr) {
+    const char* blanks = " \t\r\n";
+    const size_t b = expr.find_first_not_of(blanks);
+    if(b == string::npos) return string();
+    return expr.substr(b, expr.find_last_not_of(blanks) - b + 1);
+}
+
+///Parse expression and return evaluated result; syntax trees are
+///stored into cache and reused when the same expression is evaluated again
+real_t MathParser(const string& expr, ExprParser& parser, Ctx& ctx,
+                  ExprCache& cache) {
+    const string key = Normalize(expr);
+    if(auto e = cache.Find(key)) {
+        //cached tree is valid if variables map to the same slots
+        bool valid = true;
+        for(auto& v: e->vars) valid = valid && ctx.Slot(v.first) == v.second;
+        if(valid) return Evaluate(e->ast, ctx);
+    }
+    if(!parser.Parse(expr, ctx))
+        return std::numeric_limits< real_t >::quiet_NaN();
+    //record variables referenced by tree
+    std::set< size_t > keys;
+    ctx.ast.Apply([&keys](const Term& t) {
+        if(t.type == VAR) keys.insert(size_t(t.value));
+    });
+    Expression e{ctx.ast, {}};
+    size_t size = sizeof(Expression)
+                  + ctx.ast.GetTree().Size() * sizeof(AST::Tree::Node);
+    for(auto k: keys) {
+        e.vars.push_back({ctx.varkey.Name(k), k});
+        size += sizeof(e.vars.front()) + e.vars.back().first.size();
+    }
+    return Evaluate(cache.Insert(key, std::move(e), size)->ast, ctx);
+}
+
+#ifdef PROGRAM_EVAL
+///Batch mode: evaluates expression once per row of variable values read
+///from standard input, one row per line, values listed in the order in
+///which variables first appear in the expression; the expression is
+///compiled once and evaluated column-wise through Program::RunBatch
+int Batch(const string& expr) {
+    Ctx ctx;
+    ExprParser parser;
+    if(!parser.Parse(expr, ctx)) return 1;
+    if(ctx.ast.GetTree().Empty() || Assigns(ctx.ast)) {
+        cerr << "batch mode requires an expression with no assignments"
+             << endl;
+        return 1;
+    }
+    auto p = Compile(ctx.ast, ctx, F());
+    vector< vector< real_t > > columns(ctx.varkey.Size());
+    size_t rows = 0;
+    string line;
+    while(getline(cin, line)) {
+        if(line.empty()) break;
+        istringstream iss(line);
+        for(auto& c: columns) {
+            real_t v = 0;
+            if(!(iss >> v)) {
+                cerr << "ERROR AT ROW: " << rows << endl;
+                return 1;
+            }
+            c.push_back(v);
+        }
+        ++rows;
+    }
+    vector< const real_t* > slots;
+    for(auto& c: columns) slots.push_back(c.data());
+    vector< real_t > out(rows);
+    p.RunBatch(slots.data(), out.data(), rows);
+    for(auto v: out) cout << v << '\n';
+    return 0;
+}
+#else
+///Batch mode is only available with PROGRAM_EVAL
+int Batch(const string&) {
+    cerr << "batch mode requires PROGRAM_EVAL" << endl;
+    return 1;
+}
+#endif
+
 } //anonymous namespace
 
 
 ///Entry point
-int main(int, char**) {
+///Usage: fun-math-parser [-batch <expression>]
+int main(int argc, char** argv) {
+    if(argc > 2 && string(argv[1]) == "-batch") return Batch(argv[2]);
     //REPL, exit when input is empty
     string me;
     Ctx ctx;
+    ExprParser parser;
+    //parsed expressions, up to 1MB
+    ExprCache cache(1 << 20);
     while(getline(cin, me)) {
         if(me.empty()) break;
-        cout << "> " << MathParser(me, ctx) << endl;
+        cout << "> " << MathParser(me, parser, ctx, cache) << endl;
         //clear AST, tree is destroyed but previously defined variables are
         //kept in context data
         ctx.ast.Reset();
     }
+#ifdef CACHE_STATS
+    cerr << "cache: " << cache.Hits() << " hits, " << cache.Misses()
+         << " misses, " << cache.Count() << " expressions, " << cache.Size()
+         << " bytes" << endl;
+#endif
     return 0;
 }
@@ -7,12 +7,19 @@
 #include <functional>
 #include <cmath>
 #include <stack>
+#include <set>
 
 #include <peg.h>
+#ifdef PEG_VM
+#include <pegvm.h>
+#endif
 #include <unordered_map>
 #include <map>
 #include <InStream.h>
 #include <STree.h>
+#include <LRUCache.h>
+#include <SymbolTable.h>
+#include <STProgram.h>
 #include <types.h>
 //following is required for parser composition: (P1,P2) -> P1 & P2 -> AndParser
 #include <parser_operators.h>
@@ -90,23 +97,26 @@ using AST = STree< Term, std::map< TERM, int > >;
 
 //Variables
 //LVALUE handling: only using evaluation function supporting numbers
-//use var -> real key -> real value
-using VarToKey = std::map< string, real_t >;
-using KeyToValue = std::map< real_t, real_t >;
-using FunToKey = std::map< string, real_t >;
+//use var -> slot in symbol table -> value stored at slot index in context
 using Function = real_t (real_t, real_t);
-using KeyToFun = std::map< real_t, Function >;
 using Invokable = std::function< Function >;
-using VarKey = real_t;
-using FunKey = real_t;
     
 //Context
 struct Ctx {
+    Ctx(SymbolTable& s) : symbols(s) {}
     AST ast;
-    //variable handling
-    VarToKey varkey;
-    KeyToValue keyvalue;
-    real_t assignKey;
+    //variable handling: symbol table can be shared among contexts,
+    //each context stores its own values
+    SymbolTable& symbols;
+    std::vector< real_t > vars;
+    size_t assignKey = 0;
+    ///Returns slot of variable, variables with no value in this context
+    ///are initialized with @c init
+    size_t Slot(const string& name, real_t init) {
+        const size_t k = symbols.Add(name);
+        if(k >= vars.size()) vars.resize(k + 1, init);
+        return k;
+    }
     
     //Only required for just-in-time evaluation
     //performed from within HandleTerm2 function
@@ -114,12 +124,13 @@ struct Ctx {
     //result is stored into first element
     std::vector< real_t > values;
     
-    //Only required for deferred evaluation function built
+    //Only required for deferred evaluation program built
     //in HandleTerm3
-    //stores functions performing partial evaluation
-    //function evaluating entire expression is found in first element of array
-    using EvaluateFunction = std::function< real_t () >;
-    std::vector< EvaluateFunction > functions;
+    //stores postfix instructions, values of partial evaluations are
+    //stored on the program stack, after evaluation the value of the entire
+    //expression is found in the first element of the stack
+    using Tape = Program< real_t >;
+    Tape tape;
     
     //Required by both HandleTerm 2 and 3
     stack< TERM > opstack;
@@ -128,31 +139,19 @@ struct Ctx {
 void Reset(Ctx& c) {
     c.ast.Reset();
     c.values.clear();
-    c.functions.clear();
+    c.tape.Clear();
     c.opstack = stack< TERM >();
 }
 
-//generate new key used for variable->value mapping
-real_t GenKey() {
-    static real_t k = real_t(0);
-    return k++;
-}
-
 //Parser callback 1, simply add terms to syntax tree
 bool HandleTerm(TERM t, const Values& v, Ctx& ctx, EvalState es) {
     if(es == EvalState::BEGIN) return true;
     if(es == EvalState::FAIL) return false;
     
     if(t == VAR) {
-        if(In(Get(v), ctx.varkey)) {
-            const real_t k = Get(ctx.varkey, Get(v));
-            ctx.ast.Add({t, k});
-        } else {
-            const real_t k = GenKey();
-            ctx.varkey[Get(v)] = k;
-            ctx.keyvalue[k] = std::numeric_limits<real_t>::quiet_NaN();
-            ctx.ast.Add({t, k});
-        }
+        const size_t k =
+            ctx.Slot(Get(v), std::numeric_limits<real_t>::quiet_NaN());
+        ctx.ast.Add({t, real_t(k)});
     } else if(t == NUMBER) {
         ctx.ast.Add({t, Get(v)});
     } else if(t == CP) {
@@ -193,15 +192,12 @@ bool HandleTerm2(TERM t, const Values& v, Ctx& ctx, EvalState es) {
     if(es == EvalState::FAIL) return false;
     if(Op(t)) ctx.opstack.push(t);
     if(t == VAR) {
-        if(In(Get(v), ctx.varkey)) {
-            const real_t k = Get(ctx.varkey,Get(v));
+        const size_t k = ctx.symbols.Find(Get(v));
+        if(k < ctx.vars.size()) {
             ctx.assignKey = k;
-            ctx.values.push_back(ctx.keyvalue[k]);
+            ctx.values.push_back(ctx.vars[k]);
         } else {
-            const real_t k = GenKey();
-            ctx.varkey[Get(v)] = k;
-            ctx.keyvalue[k] = real_t();
-            ctx.assignKey = k;
+            ctx.assignKey = ctx.Slot(Get(v), real_t());
         }
     } else if(t == NUMBER) {
         const real_t r = Get(v);
@@ -262,109 +258,64 @@ bool HandleTerm2(TERM t, const Values& v, Ctx& ctx, EvalState es) {
         if(!ctx.opstack.empty()
            && ctx.opstack.top() == ASSIGN) {
             assert(ctx.values.size() > 0);
-            const real_t k = ctx.assignKey;
-            ctx.keyvalue[k] = ctx.values.back();
+            ctx.vars[ctx.assignKey] = ctx.values.back();
         }
     }
     return true;
 }
 
-///Parser callback 3: deferred evaluation function
-///Generate expression evaluation function through pattern:
-///    f = [f, fi]() {
-///        return f() + fi();
-///    };
-///where fi is the function at position i in the function array;
-///traversal path gets unrolled into functions+closured, therefore no
-///loop is executed during actual evaluation
+///Parser callback 3: deferred evaluation program
+///Generate postfix program evaluating the expression: values are pushed
+///when parsed, operators are appended when their right operand has been
+///parsed; e.g. 1 + x * 2 is translated to
+///    PUSH 1, LOAD x, PUSH 2, MUL, ADD
+///variables are read from and assigned to the context variable array
+///by slot index, the program is executed by a single loop over the
+///instructions with no function invocations for built-in operators
 bool HandleTerm3(TERM t, const Values& v, Ctx& ctx, EvalState es) {
-    auto freset = [](const Ctx::EvaluateFunction& f,
-                     std::vector< Ctx::EvaluateFunction >& a,
-                     size_t scopeLevel) {
-        assert(a.size() > scopeLevel);
-        a[scopeLevel] = f;
-        a.resize(scopeLevel + 1);
+    using Tape = Ctx::Tape;
+    static const Tape::BinaryFun power = [](real_t b, real_t e) {
+        return pow(b, e);
     };
     if(es == EvalState::BEGIN) return true;
     if(es == EvalState::FAIL) return false;
     if(Op(t)) ctx.opstack.push(t);
     if(t == VAR) {
-        if(In(Get(v), ctx.varkey)) {
-            const real_t k = Get(ctx.varkey,Get(v));
+        const size_t k = ctx.symbols.Find(Get(v));
+        if(k < ctx.vars.size()) {
             ctx.assignKey = k;
-            std::reference_wrapper< const real_t > ref(ctx.keyvalue[k]);
-            ctx.functions.push_back([ref](){ return ref.get(); });
+            ctx.tape.Append(Tape::Load(int(k)));
         } else {
-            const real_t k = GenKey();
-            ctx.varkey[Get(v)] = k;
-            ctx.keyvalue[k] = real_t();
-            ctx.assignKey = k;
+            ctx.assignKey = ctx.Slot(Get(v), real_t());
         }
     } else if(t == NUMBER) {
-        const real_t r = Get(v);
-        ctx.functions.push_back([r]() { return r; });
+        ctx.tape.Append(Tape::Push(Get(v)));
     } else if(ScopeClose(t)) {
         if(ctx.opstack.empty() || !ScopeOpen(ctx.opstack.top())) return false;
            ctx.opstack.pop();
     } else if(t == SUMTERM) {
-        if(ctx.functions.size() > 0 && !ctx.opstack.empty()) {
+        if(ctx.tape.Depth() > 1 && !ctx.opstack.empty()) {
             const TERM op = ctx.opstack.top();
-            const size_t start = In(op, ARITY) ?
-                ctx.functions.size() - ARITY[op]
-                : 0;
             if(op == PLUS) {
-                Ctx::EvaluateFunction f = ctx.functions[start];
-                for(size_t i = start + 1; i < ctx.functions.size(); ++i) {
-                    auto fi = ctx.functions[i];
-                    f = [f, fi]() {
-                        return f() + fi();
-                    };
-                }
-                freset(f, ctx.functions, start);
+                ctx.tape.Append(Tape::Arith(ARITH::ADD));
                 ctx.opstack.pop();
             } else if(op == MINUS) {
-                Ctx::EvaluateFunction f = ctx.functions[start];
-                for(size_t i = start + 1;
-                    i < ctx.functions.size(); ++i) {
-                    auto fi = ctx.functions[i];
-                    f = [f, fi](){ return f() - fi(); };
-                }
-                freset(f, ctx.functions, start);
+                ctx.tape.Append(Tape::Arith(ARITH::SUB));
                 ctx.opstack.pop();
             }
         }
         
     } else if(t == PRODTERM) {
-        if(ctx.functions.size() > 0 && !ctx.opstack.empty()) {
+        if(ctx.tape.Depth() > 1 && !ctx.opstack.empty()) {
             const TERM op = ctx.opstack.top();
-            const size_t start = In(op, ARITY) ?
-                ctx.functions.size() - ARITY[op]
-                : 0;
             if(op == MUL) {
-                Ctx::EvaluateFunction f = ctx.functions[start];
-                for(size_t i = start + 1; i < ctx.functions.size(); ++i) {
-                    auto fi = ctx.functions[i];
-                    f = [f, fi]() {
-                        return f() * fi();
-                    };
-                }
-                freset(f, ctx.functions, start);
+                ctx.tape.Append(Tape::Arith(ARITH::MUL));
                 ctx.opstack.pop();
             } else if(op == DIV) {
-                Ctx::EvaluateFunction f = ctx.functions[start];
-                for(size_t i = start + 1; i < ctx.functions.size(); ++i) {
-                    auto fi = ctx.functions[i];
-                    f = [f, fi]() { return f() / fi(); };
-                }
-                freset(f, ctx.functions, start);
+                ctx.tape.Append(Tape::Arith(ARITH::DIV));
                 ctx.opstack.pop();
             } else if(op == POW) {
-                Ctx::EvaluateFunction f = ctx.functions[start];
-                for(size_t i = start + 1; i < ctx.functions.size(); ++i) {
-                    auto fi = ctx.functions[i];
-                    f = [f, fi]() { return pow(f(), fi()); };
-                }
-                freset(f, ctx.functions, start);
+                ctx.tape.Append(Tape::Fold(&power));
                 ctx.opstack.pop();
             }
         }
@@ -375,23 +326,13 @@ bool HandleTerm3(TERM t, const Values& v, Ctx& ctx, EvalState es) {
         //there is no further action to be taken
         if(!ctx.opstack.empty()
            && ctx.opstack.top() == ASSIGN) {
-            assert(ctx.functions.size() > 0);
-            const real_t k = ctx.assignKey;
-            const size_t start = ctx.functions.size() - 1;
-            const Ctx::EvaluateFunction v = ctx.functions[start];
-            std::reference_wrapper<real_t> ref = ctx.keyvalue[k];
-            Ctx::EvaluateFunction f = [ref, k, v]() {
-                const real_t r = v();
-                ref.get() = r;
-                return r;
-            };
-            freset(f, ctx.functions, start);
+            assert(ctx.tape.Depth() > 0);
+            ctx.tape.Append(Tape::Store(int(ctx.assignKey)));
             ctx.opstack.pop();
         }
     }
     return true;
 }
-
     
 ///In case a hash map is used it is required to provide a hash  key generation
 ///function
@@ -416,20 +357,18 @@ using ActionFun = std::function< bool (TERM, const Values&, Ctx&, EvalState) >;
     DEFINE_HASH(TERM)
 #endif
 #ifdef HASH_MAP
-    using Map = std::unordered_map< TERM, EvalFun >;
     using ActionMap = std::unordered_map< TERM, ActionFun >;
 #else
-    using ParsingRules = std::map< TERM, EvalFun >;
     using ActionMap = std::map< TERM, ActionFun  >;
 #endif
+    using ParsingRules = Grammar< TERM, ActionMap, Ctx >;
     
-///Generate parser table map: each element represent a parsing rule
-ParsingRules GenerateParser(ActionMap& am, Ctx& ctx) {
+///Generate parser table: each element represent a parsing rule
+void GenerateParser(ParsingRules& g) {
     
-    ParsingRules g; // grammar
-    auto n  = MAKE_CALL(TERM, g, am, ctx);
-    auto c  = MAKE_CBCALL(TERM, g, am, ctx);
-    auto mt = MAKE_EVAL(TERM, g, am, ctx);
+    auto n  = [&g](TERM t) { return g.Call(t); };
+    auto c  = [&g](TERM t) { return g.CBCall(t); };
+    auto mt = [&g](TERM t, Parser p) { return g.Term(t, p); };
     
     //grammar definition
     //non-terminal - note the top-down definition through deferred calls using
@@ -488,33 +427,68 @@ ParsingRules GenerateParser(ActionMap& am, Ctx& ctx) {
     g[ASSIGN] = mt(ASSIGN, CS("<-"));
     g[VAR]    = mt(VAR, VS());
     
-    return g;
+    g.Link();
 }
 
 }
 
-///Parse expression and return evaluated result
-real_t MathParser(const string& expr, Ctx& ctx) {
-    istringstream iss(expr);
-    InStream is(iss);//, [](Char c) {return c == ' ' || c == '\t';});
-    ctx.ast.SetWeights(weights);
-    ActionMap am;
+///Expression parser: the grammar is generated once and reused for all the
+///expressions, the context is bound at each parse
+class ExprParser {
+public:
+    ExprParser() : g_(am_) {
 #if defined(INLINE_EVAL)
-    auto HT = HandleTerm2;
+        auto HT = HandleTerm2;
 #elif defined(FUN_EVAL)
-    auto HT = HandleTerm3;
+        auto HT = HandleTerm3;
+#else
+        auto HT = HandleTerm;
+#endif
+        Set(am_, HT, NUMBER,
+            EXPR, OP, CP, PLUS, MINUS, MUL, DIV, POW, SUM, PRODUCT, VALUE,
+            ASSIGN, ASSIGNMENT, VAR, SUMTERM, PRODTERM);
+        //handlers only act on PASS: BEGIN and FAIL events are not dispatched
+        g_.SetEvents(PASS_EVENT);
+        GenerateParser(g_);
+#ifdef PEG_VM
+        vm_.reset(new GrammarVM< TERM, ActionMap, Ctx >(g_));
+#endif
+    }
+    ExprParser(const ExprParser&) = delete;
+    ExprParser& operator=(const ExprParser&) = delete;
+    ///Parse expression, returns false in case of parsing error
+    bool Parse(const string& expr, Ctx& ctx) {
+        istringstream iss(expr);
+        InStream is(iss);//, [](Char c) {return c == ' ' || c == '\t';});
+        ctx.ast.SetWeights(weights);
+        g_.SetContext(ctx);
+        g_.Reset();
+#ifdef PEG_VM
+        vm_->Run(START, is);
 #else
-    auto HT = HandleTerm;
+        g_[START](is);
+#endif
+        if(is.tellg() < expr.size()) {
+            cerr << "ERROR AT: " << is.tellg() << endl;
+            return false;
+        }
+        return true;
+    }
+private:
+    ActionMap am_;
+    ParsingRules g_;
+#ifdef PEG_VM
+    std::unique_ptr< GrammarVM< TERM, ActionMap, Ctx > > vm_;
 #endif
-    Set(am, HT, NUMBER,
-        EXPR, OP, CP, PLUS, MINUS, MUL, DIV, POW, SUM, PRODUCT, VALUE,
-        ASSIGN, ASSIGNMENT, VAR, SUMTERM, PRODTERM);
-    ParsingRules g = GenerateParser(am, ctx);
-    g[START](is);
-    if(is.tellg() < expr.size()) cerr << "ERROR AT: " << is.tellg() << endl;
-    using Op = std::function< real_t (real_t, real_t) >;
-    using Ops = std::map< TERM, Op >;
-    Ops ops = {
+};
+
+#if !defined(INLINE_EVAL) && !defined(FUN_EVAL)
+using OpFun = std::function< real_t (real_t, real_t) >;
+using OpMap = std::map< TERM, OpFun >;
+
+///Returns functions evaluating each node type of syntax tree
+OpMap Operations(Ctx& ctx) {
+    return {
         {NUMBER, [](real_t n, real_t) { return n; }},
         {PLUS, [](real_t v1, real_t v2) { return v1 + v2; }},
         {MINUS, [](real_t v1, real_t v2) { return v1 - v2; }},
@@ -524,45 +498,200 @@ real_t MathParser(const string& expr, Ctx& ctx) {
         {OP, [](real_t v, real_t a) { return v; }},
         {CP, [](real_t v, real_t ) { return v; }},
         {ASSIGN, [&ctx](real_t key, real_t value ) {
-            ctx.keyvalue[ctx.assignKey] = value;
+            ctx.vars[ctx.assignKey] = value;
             return value;
         }},
         {VAR, [&ctx](real_t k, real_t v) {
-            ctx.assignKey = k;
-            return ctx.keyvalue[k];
+            ctx.assignKey = size_t(k);
+            return ctx.vars[ctx.assignKey];
         }}
     };
+}
 
-   // const real_t ret = ctx.ast.Eval(ops);
-#if defined(INLINE_EVAL)
-    return ctx.values.front();
-#elif defined(FUN_EVAL)
-    return ctx.functions.front()();
-#else
+///Evaluate syntax tree
+real_t Evaluate(const AST& ast, Ctx& ctx) {
+    const OpMap ops = Operations(ctx);
 #ifdef PRINT_TREE
     int s = 0;
     cout << '\n';
-    ctx.ast.Apply([s](const Term& t) mutable {
+    ast.Apply([s](const Term& t) mutable {
         if(ScopeBegin(t)) s += 2;
         else if(ScopeEnd(t)) s -= 2;
         cout << string(s, '.') << t.type << endl;
     });
 #endif
-    return ctx.ast.Eval(ops);
+#ifdef PROGRAM_EVAL
+    //constant subexpressions are folded and repeated ones evaluated once,
+    //variable access and assignment have side effects
+    auto p = CompileEval(ast.GetTree(), ops,
+                         [](const Term&) { return -1; },
+                         [](const Term&) { return ARITH::NONE; },
+                         [](const Term& t) {
+                             return t.type != VAR && t.type != ASSIGN;
+                         });
+    p.Optimize();
+    return p.Run();
+#else
+    return ast.Eval(ops);
+#endif
+}
+#endif
+
+///Parsed expression: syntax tree and slots of the variables it references
+struct Expression {
+    AST ast;
+    std::vector< std::pair< string, size_t > > vars;
+};
+
+///Parsed expressions keyed by expression text, shared among threads
+using ExprCache = LRUCache< string, Expression >;
+
+///Removes leading and trailing blanks
+string Normalize(const string& expr) {
+    const char* blanks = " \t\r\n";
+    const size_t b = expr.find_first_not_of(blanks);
+    if(b == string::npos) return string();
+    return expr.substr(b, expr.find_last_not_of(blanks) - b + 1);
+}
+
+#if defined(INLINE_EVAL) || defined(FUN_EVAL)
+///Parse expression and return evaluated result; values are computed while
+///parsing, no syntax tree is cached
+real_t MathParser(const string& expr, ExprParser& parser, Ctx& ctx,
+                  ExprCache&) {
+    parser.Parse(expr, ctx);
+#if defined(INLINE_EVAL)
+    return ctx.values.front();
+#else
+    if(ctx.tape.GetCode().empty())
+        return std::numeric_limits<real_t>::quiet_NaN();
+    return ctx.tape.Run(ctx.vars.data(), ctx.vars.data());
 #endif
 }
+#else
+///Parse expression and return evaluated result; syntax trees are
+///stored into cache and reused when the same expression is evaluated again
+real_t MathParser(const string& expr, ExprParser& parser, Ctx& ctx,
+                  ExprCache& cache) {
+    const string key = Normalize(expr);
+    if(auto e = cache.Find(key)) {
+        //cached tree is valid if variables map to the same slots, always
+        //true when the symbol table is shared among all contexts
+        bool valid = true;
+        for(auto& v: e->vars) {
+            valid = valid
+                && ctx.Slot(v.first, std::numeric_limits<real_t>::quiet_NaN())
+                   == v.second;
+        }
+        if(valid) return Evaluate(e->ast, ctx);
+    }
+    if(!parser.Parse(expr, ctx)) return Evaluate(ctx.ast, ctx);
+    //record variables referenced by tree
+    std::set< size_t > keys;
+    ctx.ast.Apply([&keys](const Term& t) {
+        if(t.type == VAR) keys.insert(size_t(t.value));
+    });
+    Expression e{ctx.ast, {}};
+    size_t size = sizeof(Expression)
+                  + ctx.ast.GetTree().Size() * sizeof(AST::Tree::Node);
+    for(auto k: keys) {
+        e.vars.push_back({ctx.symbols.Name(k), k});
+        size += sizeof(e.vars.front()) + e.vars.back().first.size();
+    }
+    return Evaluate(cache.Insert(key, std::move(e), size)->ast, ctx);
+}
+#endif
 
+#if defined(INLINE_EVAL) || defined(FUN_EVAL)
+///Batch mode is not available: values are computed while parsing,
+///variables are only read when previously assigned
+int Batch(const string&) {
+    cerr << "batch mode requires syntax tree evaluation" << endl;
+    return 1;
+}
+#else
+///Batch mode: evaluates expression once per row of variable values read
+///from standard input, one row per line, values listed in the order in
+///which variables first appear in the expression; the expression is
+///compiled once and evaluated column-wise through Program::RunBatch
+int Batch(const string& expr) {
+    SymbolTable symbols;
+    Ctx ctx(symbols);
+    ExprParser parser;
+    if(!parser.Parse(expr, ctx)) return 1;
+    bool assigns = false;
+    ctx.ast.Apply([&assigns](const Term& t) {
+        assigns = assigns || t.type == ASSIGN;
+    });
+    const OpMap ops = Operations(ctx);
+    //variables are loaded from columns, constant subexpressions folded
+    auto p = CompileEval(ctx.ast.GetTree(), ops,
+                         [](const Term& t) {
+                             return t.type == VAR ? int(t.value) : -1;
+                         },
+                         [](const Term& t) {
+                             switch(t.type) {
+                                 case PLUS:  return ARITH::ADD;
+                                 case MINUS: return ARITH::SUB;
+                                 case MUL:   return ARITH::MUL;
+                                 case DIV:   return ARITH::DIV;
+                                 default:    return ARITH::NONE;
+                             }
+                         },
+                         [](const Term&) { return true; });
+    p.Optimize();
+    if(assigns || p.GetCode().empty()) {
+        cerr << "batch mode requires an expression with no assignments"
+             << endl;
+        return 1;
+    }
+    vector< vector< real_t > > columns(symbols.Size());
+    size_t rows = 0;
+    string line;
+    while(getline(cin, line)) {
+        if(line.empty()) break;
+        istringstream iss(line);
+        for(auto& c: columns) {
+            real_t v = 0;
+            if(!(iss >> v)) {
+                cerr << "ERROR AT ROW: " << rows << endl;
+                return 1;
+            }
+            c.push_back(v);
+        }
+        ++rows;
+    }
+    vector< const real_t* > slots;
+    for(auto& c: columns) slots.push_back(c.data());
+    vector< real_t > out(rows);
+    p.RunBatch(slots.data(), out.data(), rows);
+    for(auto v: out) cout << v << '\n';
+    return 0;
+}
+#endif
 
 ///Entry point
-int main(int, char**) {
+///Usage: math-parser [-batch <expression>]
+int main(int argc, char** argv) {
+    if(argc > 2 && string(argv[1]) == "-batch") return Batch(argv[2]);
 
     //REPL, exit when input is empty
     string me;
-    Ctx ctx;
+    //variable names, can be shared by contexts in multiple threads
+    SymbolTable symbols;
+    Ctx ctx(symbols);
+    ExprParser parser;
+    //parsed expressions, up to 1MB
+    ExprCache cache(1 << 20);
     while(getline(cin, me)) {
         if(me.empty()) break;
-        cout << "> " << MathParser(me, ctx) << endl;
+        cout << "> " << MathParser(me, parser, ctx, cache) << endl;
         Reset(ctx);
     }
+#ifdef CACHE_STATS
+    cerr << "cache: " << cache.Hits() << " hits, " << cache.Misses()
+         << " misses, " << cache.Count() << " expressions, " << cache.Size()
+         << " bytes" << endl;
+#endif
     return 0;
 }
@@ -0,0 +1,106 @@
+//Example: reads the ATOM and HETATM records of a PDB file into a vector of
+//structures through binding parsers, without building any value map
+//Usage: pdb-binding <pdb file>
+//e.g. pdb-binding data/AGTC.pdb
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <InStream.h>
+#include <binding.h>
+
+using namespace std;
+
+namespace {
+//==============================================================================
+using namespace parsley;
+
+struct Atom {
+    unsigned serial = 0;
+    String name;
+    String residue;
+    String chain;
+    int residueSeq = 0;
+    double x = 0, y = 0, z = 0;
+};
+
+struct NotBlankChars {
+    static constexpr CharClass Value() { return ~SpaceChars::Value(); }
+};
+
+using TokenParser = SequenceParser< CharClassValidator< NotBlankChars > >;
+using ChainParser = SequenceParser< CharClassValidator< AlphaChars > >;
+
+///Returns parser appending one element to atoms per ATOM or HETATM record
+///and skipping all the other records
+Parser PDBParser(vector< Atom >& atoms) {
+    Binding< Atom > atom;
+    OrParser keyword;
+    keyword.Add(ConstStringParser("ATOM")).Add(ConstStringParser("HETATM"));
+    AndParser record;
+    record.Add(keyword)
+          .Add(Member(atom, &Atom::serial, UIntParser()))
+          .Add(Member(atom, &Atom::name, TokenParser()))
+          .Add(Member(atom, &Atom::residue, TokenParser()))
+          //chain identifier is optional
+          .Add(OptionalParser(Member(atom, &Atom::chain, ChainParser())))
+          .Add(Member(atom, &Atom::residueSeq, IntParser()))
+          .Add(Setter(atom, [](Atom& a, double x) { a.x = x; }, FloatParser()))
+          .Add(Member(atom, &Atom::y, FloatParser()))
+          .Add(Member(atom, &Atom::z, FloatParser()))
+          .Add(SkipToNextLineParser());
+    AndParser skip;
+    skip.Add(TokenParser()).Add(SkipToNextLineParser());
+    OrParser line;
+    line.Add(BoundRecordParser< Atom >(atom, record, atoms)).Add(skip);
+    return MultiParser(line);
+}
+
+}
+
+///Entry point
+int main(int argc, char** argv) {
+    if(argc != 2) {
+        cerr << "usage: " << argv[0] << " <pdb file>" << endl;
+        return 1;
+    }
+    ifstream ifs(argv[1]);
+    if(!ifs) {
+        cerr << "cannot open " << argv[1] << endl;
+        return 1;
+    }
+    vector< Atom > atoms;
+    Parser p = PDBParser(atoms);
+    InStream is(ifs);
+    const auto start = chrono::steady_clock::now();
+    const bool ok = p.Parse(is);
+    const double ms = chrono::duration< double, milli >(
+                          chrono::steady_clock::now() - start).count();
+    if(!ok) {
+        cerr << argv[1] << ": parsing failed" << endl;
+        return 1;
+    }
+    double x = 0, y = 0, z = 0;
+    size_t residues = 0;
+    for(size_t i = 0; i != atoms.size(); ++i) {
+        x += atoms[i].x;
+        y += atoms[i].y;
+        z += atoms[i].z;
+        if(i == 0 || atoms[i].residueSeq != atoms[i - 1].residueSeq
+           || atoms[i].chain != atoms[i - 1].chain) ++residues;
+    }
+    cout << argv[1] << ": " << atoms.size() << " atoms, " << residues
+         << " residues, " << ms << " ms" << endl;
+    if(!atoms.empty()) {
+        const double n = double(atoms.size());
+        cout << "first: " << atoms.front().name << ' ' << atoms.front().residue
+             << ' ' << atoms.front().residueSeq << "\nlast: "
+             << atoms.back().name << ' ' << atoms.back().residue << ' '
+             << atoms.back().residueSeq << "\ncenter: " << x / n << ' '
+             << y / n << ' ' << z / n << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#pragma once
+//Grammar and actions shared by the peg.h benchmarks: ';' separated
+//arithmetic expressions, actions sum the parsed numbers
+
+#include <functional>
+#include <map>
+#include <string>
+
+#include <peg.h>
+#include <InStream.h>
+#include <types.h>
+#include <parsers.h>
+//following is required for parser composition: (P1,P2) -> P1 & P2 -> AndParser
+#include <parser_operators.h>
+
+namespace pegbench {
+//==============================================================================
+using namespace parsley;
+
+///Term type
+enum TERM {START = 1, EXPR, SUM, PRODUCT, VALUE, NUMBER, OP, CP, PLUS, MINUS,
+           MUL, DIV, SEP};
+
+///Context: sum of parsed numbers and number of dispatched events
+struct Ctx {
+    double sum = 0;
+    size_t events = 0;
+};
+
+using ActionFun = std::function< bool (TERM, const Values&, Ctx&, EvalState) >;
+using ActionMap = std::map< TERM, ActionFun >;
+using ParsingRules = Grammar< TERM, ActionMap, Ctx >;
+
+///Same structure as the math-parser handlers: BEGIN and FAIL are no-ops
+inline bool HandleTerm(TERM t, const Values& v, Ctx& ctx, EvalState es) {
+    ++ctx.events;
+    if(es == EvalState::BEGIN) return true;
+    if(es == EvalState::FAIL) return false;
+    if(t == NUMBER) ctx.sum += double(Get(v));
+    return true;
+}
+
+///Maps all the terms except START to HandleTerm
+inline ActionMap Actions() {
+    ActionMap am;
+    Set(am, HandleTerm, EXPR, SUM, PRODUCT, VALUE, NUMBER, OP, CP, PLUS,
+        MINUS, MUL, DIV, SEP);
+    return am;
+}
+
+inline void GenerateParser(ParsingRules& g) {
+    auto n  = [&g](TERM t) { return g.Call(t); };
+    auto mt = [&g](TERM t, Parser p) { return g.Term(t, p); };
+    g[START]   = (n(EXPR), *(n(SEP), n(EXPR)));
+    g[EXPR]    = n(SUM);
+    g[SUM]     = (n(PRODUCT), *((n(PLUS) / n(MINUS)), n(PRODUCT)));
+    g[PRODUCT] = (n(VALUE), *((n(MUL) / n(DIV)), n(VALUE)));
+    g[VALUE]   = (n(OP), n(EXPR), n(CP)) / n(NUMBER);
+    using FP = FloatParser;
+    using CS = ConstStringParser;
+    g[NUMBER] = mt(NUMBER, FP());
+    g[OP]     = mt(OP,     CS("("));
+    g[CP]     = mt(CP,     CS(")"));
+    g[PLUS]   = mt(PLUS,   CS("+"));
+    g[MINUS]  = mt(MINUS,  CS("-"));
+    g[MUL]    = mt(MUL,    CS("*"));
+    g[DIV]    = mt(DIV,    CS("/"));
+    g[SEP]    = mt(SEP,    CS(";"));
+    g.Link();
+}
+
+///Returns input made of the specified number of expressions
+inline std::string Input(int expressions) {
+    std::string expr = "1";
+    for(int i = 0; i != expressions; ++i) expr += ";(2*3.5-4/(5+6))*7+1";
+    return expr;
+}
+
+}
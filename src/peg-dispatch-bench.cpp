@@ -0,0 +1,49 @@
+//Benchmark: cost of action dispatch in peg.h Grammar with and without
+//event masks
+//Usage: peg-dispatch-bench [number of expressions]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "peg-bench.h"
+
+using namespace std;
+
+namespace {
+//==============================================================================
+using namespace pegbench;
+
+///Parses ';' separated expressions with the specified event mask,
+///prints elapsed time and number of dispatched events
+void Run(const string& label, unsigned events, const string& expr) {
+    ActionMap am = Actions();
+    Ctx ctx;
+    ParsingRules g(am, ctx);
+    g.SetEvents(events);
+    GenerateParser(g);
+    const auto start = chrono::steady_clock::now();
+    istringstream iss(expr);
+    InStream is(iss);
+    if(!g[START](is) || is.tellg() < StreamOff(expr.size())) {
+        cerr << "ERROR AT: " << is.tellg() << endl;
+        return;
+    }
+    const auto end = chrono::steady_clock::now();
+    const double ms =
+        chrono::duration< double, milli >(end - start).count();
+    cout << label << ": " << ms << " ms, "
+         << ctx.events << " events, sum " << ctx.sum << endl;
+}
+
+}
+
+///Entry point
+int main(int argc, char** argv) {
+    const string expr = Input(argc > 1 ? atoi(argv[1]) : 100000);
+    Run("all events ", ALL_EVENTS, expr);
+    Run("pass events", PASS_EVENT, expr);
+    return 0;
+}
@@ -0,0 +1,52 @@
+//Benchmark: peg.h Grammar evaluated through closures and through the
+//bytecode interpreter in pegvm.h
+//Usage: peg-vm-bench [number of expressions]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <pegvm.h>
+#include "peg-bench.h"
+
+using namespace std;
+
+namespace {
+//==============================================================================
+using namespace pegbench;
+
+///Parses ';' separated expressions with closures or bytecode, prints
+///elapsed time and number of dispatched events
+void Run(const string& label, bool vm, const string& expr) {
+    ActionMap am = Actions();
+    Ctx ctx;
+    ParsingRules g(am, ctx);
+    g.SetEvents(PASS_EVENT);
+    GenerateParser(g);
+    GrammarVM< TERM, ActionMap, Ctx > program(g);
+    const auto start = chrono::steady_clock::now();
+    istringstream iss(expr);
+    InStream is(iss);
+    const bool pass = vm ? program.Run(START, is) : g[START](is);
+    if(!pass || is.tellg() < StreamOff(expr.size())) {
+        cerr << "ERROR AT: " << is.tellg() << endl;
+        return;
+    }
+    const auto end = chrono::steady_clock::now();
+    const double ms =
+        chrono::duration< double, milli >(end - start).count();
+    cout << label << ": " << ms << " ms, "
+         << ctx.events << " events, sum " << ctx.sum << endl;
+}
+
+}
+
+///Entry point
+int main(int argc, char** argv) {
+    const string expr = Input(argc > 1 ? atoi(argv[1]) : 100000);
+    Run("closures", false, expr);
+    Run("bytecode", true, expr);
+    return 0;
+}
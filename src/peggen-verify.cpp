@@ -0,0 +1,178 @@
+//Verifies a parser generated by peggen against the same grammar evaluated
+//at run time through peg.h, on a set of input files; also checks that
+//grammars with repetitions of nullable expressions are rejected
+//Usage: peggen-verify <grammar file> <input files...>
+//The generated header records.gen.h must be built from the same grammar
+//file: peggen src/grammars/records.peg records records.gen.h
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <peg.h>
+#include <peggen.h>
+#include <InStream.h>
+#include <types.h>
+
+#include "records.gen.h"
+
+using namespace std;
+
+namespace {
+//==============================================================================
+using namespace parsley;
+
+///Number of matches per rule
+using Counts = vector< size_t >;
+
+using ActionFun = std::function< bool (int, const Values&, Counts&, EvalState) >;
+using ActionMap = std::map< int, ActionFun >;
+using ParsingRules = Grammar< int, ActionMap, Counts >;
+
+///Parsing result: success, number of consumed characters and matches per rule
+struct Result {
+    bool pass;
+    size_t pos;
+    Counts counts;
+    double ms;
+};
+
+bool operator!=(const Result& r1, const Result& r2) {
+    return r1.pass != r2.pass || r1.pos != r2.pos || r1.counts != r2.counts;
+}
+
+double Elapsed(chrono::steady_clock::time_point start) {
+    return chrono::duration< double, milli >(
+        chrono::steady_clock::now() - start).count();
+}
+
+///Evaluates grammar through peg.h combinators
+Result Interpreted(const PegGrammar& pg, const string& text) {
+    Result r;
+    r.counts.assign(pg.rules.size(), 0);
+    ActionMap am;
+    for(int i = 0; i != int(pg.rules.size()); ++i) {
+        am[i] = [](int k, const Values&, Counts& c, EvalState) {
+            ++c[k];
+            return true;
+        };
+    }
+    //no memoization: pure PEG semantics, same as generated code
+    MemoTable< int > memo(MemoPolicy::NONE);
+    ParsingRules g(am, r.counts, &memo);
+    g.SetEvents(PASS_EVENT);
+    BuildGrammar(pg, g);
+    g.Link();
+    istringstream iss(text);
+    InStream is(iss);
+    const auto start = chrono::steady_clock::now();
+    r.pass = g[0](is);
+    r.ms = Elapsed(start);
+    r.pos = is.tellg() < 0 ? text.size() : size_t(is.tellg());
+    return r;
+}
+
+///Handler for generated parser
+struct Counter {
+    Counts& counts;
+    bool operator()(records::Rule r, const char*, const char*) {
+        ++counts[r];
+        return true;
+    }
+};
+
+///Evaluates grammar through generated code
+Result Generated(const PegGrammar& pg, const string& text) {
+    Result r;
+    r.counts.assign(pg.rules.size(), 0);
+    Counter c = {r.counts};
+    records::Parser< Counter > p(c);
+    const auto start = chrono::steady_clock::now();
+    r.pass = p.Parse(text.data(), text.data() + text.size());
+    r.ms = Elapsed(start);
+    r.pos = p.Pos();
+    return r;
+}
+
+///Checks that repetitions of expressions matching the empty string, which
+///would never terminate, are rejected by the grammar reader
+int CheckNullableRepetitions() {
+    const char* rejected[] = {
+        "a <- ('x'?)* ;",
+        "a <- ('x' / 'y'*)+ ;",
+        "a <- b* 'x' ; b <- c ; c <- 'y'? 'z'* ;"
+    };
+    const char* accepted[] = {
+        "a <- ('x' 'y'?)* ;",
+        "a <- b* ; b <- 'x' b / 'y' ;"
+    };
+    int errors = 0;
+    for(const char* g: rejected) {
+        try {
+            ReadPegGrammar(g);
+            cout << "nullable repetition: '" << g << "' NOT REJECTED" << endl;
+            ++errors;
+        } catch(const exception&) {}
+    }
+    for(const char* g: accepted) {
+        try {
+            ReadPegGrammar(g);
+        } catch(const exception& e) {
+            cout << "nullable repetition: '" << g << "' REJECTED: "
+                 << e.what() << endl;
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+string Read(const char* fname) {
+    ifstream is(fname, ios::binary);
+    ostringstream os;
+    os << is.rdbuf();
+    return os.str();
+}
+
+}
+
+///Entry point
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        cerr << "usage: " << argv[0] << " <grammar file> <input files...>"
+             << endl;
+        return 1;
+    }
+    PegGrammar pg;
+    try {
+        pg = ReadPegGrammar(Read(argv[1]));
+    } catch(const exception& e) {
+        cerr << argv[1] << ": " << e.what() << endl;
+        return 1;
+    }
+    int errors = CheckNullableRepetitions();
+    for(int f = 2; f != argc; ++f) {
+        const string text = Read(argv[f]);
+        const Result i = Interpreted(pg, text);
+        const Result g = Generated(pg, text);
+        cout << argv[f] << ": " << text.size() << " chars, "
+             << (g.pass ? "pass" : "fail") << ", " << g.pos << " consumed, "
+             << "interpreted " << i.ms << " ms, generated " << g.ms << " ms";
+        if(i != g) {
+            ++errors;
+            cout << " MISMATCH: interpreted " << (i.pass ? "pass" : "fail")
+                 << ", " << i.pos << " consumed";
+            for(size_t k = 0; k != pg.rules.size(); ++k) {
+                if(i.counts[k] != g.counts[k]) {
+                    cout << ", " << pg.rules[k].name << ' ' << i.counts[k]
+                         << '/' << g.counts[k];
+                }
+            }
+        }
+        cout << endl;
+    }
+    return errors ? 1 : 0;
+}
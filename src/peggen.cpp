@@ -0,0 +1,48 @@
+//Grammar to C++ code generator
+//Usage: peggen <grammar file> <namespace> [output file]
+//Writes a header containing a recursive descent parser for the grammar,
+//see include/peggen.h for the grammar syntax and the generated interface.
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <peggen.h>
+
+using namespace std;
+using namespace parsley;
+
+///Entry point
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        cerr << "usage: " << argv[0]
+             << " <grammar file> <namespace> [output file]" << endl;
+        return 1;
+    }
+    ifstream is(argv[1]);
+    if(!is) {
+        cerr << "cannot open " << argv[1] << endl;
+        return 1;
+    }
+    ostringstream text;
+    text << is.rdbuf();
+    try {
+        const PegGrammar g = ReadPegGrammar(text.str());
+        ostringstream code;
+        GeneratePegParser(g, code, argv[2], argv[1]);
+        if(argc > 3) {
+            ofstream os(argv[3]);
+            if(!os) {
+                cerr << "cannot open " << argv[3] << endl;
+                return 1;
+            }
+            os << code.str();
+        } else cout << code.str();
+    } catch(const exception& e) {
+        cerr << argv[1] << ": " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
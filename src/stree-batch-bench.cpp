@@ -0,0 +1,97 @@
+//Benchmark: evaluation of a syntax tree over columns of variable values,
+//throughput of STree::Eval, Program::Run and Program::RunBatch
+//Usage: stree-batch-bench [number of rows]
+//Build with -mavx2 or -mavx512f to enable vectorized batch operations
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <STProgram.h>
+#include "stree-expr-bench.h"
+
+using namespace std;
+
+namespace {
+//==============================================================================
+using namespace streebench;
+
+///Prints throughput, returns checksum of output column
+real_t Report(const string& label, double ms, const vector< real_t >& out) {
+    real_t sum = 0;
+    for(auto v: out) sum += v;
+    cout << label << ": " << ms << " ms, " << out.size() / ms * 1000
+         << " evaluations/s, sum " << sum << endl;
+    return sum;
+}
+
+}
+
+///Entry point
+int main(int argc, char** argv) {
+    const size_t rows = argc > 1 ? size_t(atoi(argv[1])) : 1000000;
+    AST ast(Weights());
+    Build(ast, Terms());
+    //variable columns
+    vector< real_t > x(rows);
+    vector< real_t > y(rows);
+    for(size_t i = 0; i != rows; ++i) {
+        x[i] = i * 0.001;
+        y[i] = 1 - i * 0.002;
+    }
+    const real_t* columns[] = {x.data(), y.data()};
+    vector< real_t > vars(2);
+    const auto ops = Ops(vars);
+    auto slot = [](const Term& t) {
+        return t.type == VAR ? int(t.value) : -1;
+    };
+    auto arith = [](const Term& t) {
+        switch(t.type) {
+            case PLUS:  return ARITH::ADD;
+            case MINUS: return ARITH::SUB;
+            case MUL:   return ARITH::MUL;
+            case DIV:   return ARITH::DIV;
+            default:    return ARITH::NONE;
+        }
+    };
+    vector< real_t > out(rows);
+    auto start = Clock::now();
+    for(size_t i = 0; i != rows; ++i) {
+        vars[0] = x[i];
+        vars[1] = y[i];
+        out[i] = ast.Eval(ops);
+    }
+    const real_t ref = Report("tree eval       ", Ms(start), out);
+    auto p = CompileEval(ast.GetTree(), ops, slot);
+    start = Clock::now();
+    for(size_t i = 0; i != rows; ++i) {
+        vars[0] = x[i];
+        vars[1] = y[i];
+        out[i] = p.Run(vars.data());
+    }
+    bool ok = Report("program         ", Ms(start), out) == ref;
+    start = Clock::now();
+    p.RunBatch(columns, out.data(), rows);
+    ok = Report("batch           ", Ms(start), out) == ref && ok;
+    auto pa = CompileEval(ast.GetTree(), ops, slot, arith);
+    start = Clock::now();
+    pa.RunBatch(columns, out.data(), rows);
+    ok = Report("batch, built-in ", Ms(start), out) == ref && ok;
+    //numbers folded into constants
+    auto po = CompileEval(ast.GetTree(), ops, slot, arith, [](const Term& t) {
+        return t.type != VAR;
+    });
+    po.Optimize();
+    start = Clock::now();
+    po.RunBatch(columns, out.data(), rows);
+    ok = Report("batch, optimized", Ms(start), out) == ref && ok;
+#if defined(__AVX512F__)
+    cout << "AVX-512" << endl;
+#elif defined(__AVX__)
+    cout << "AVX" << endl;
+#else
+    cout << "scalar" << endl;
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+//Benchmark: STree construction and traversal of degenerate trees
+//Usage: stree-bench [number of nodes]
+//Trees are 10^6 nodes deep by default: a long sum 1+1+...+1 builds a left
+//deep chain of '+' nodes; a sequence of terms with increasing weights
+//builds a chain where each node is the only child of the previous one
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include <STree.h>
+
+using namespace std;
+
+namespace {
+//==============================================================================
+using namespace parsley;
+
+enum TERM {NUMBER = 1, PLUS};
+
+struct Term {
+    TERM type;
+    double value;
+};
+
+//required customization points
+bool ScopeBegin(const Term&) { return false; }
+bool ScopeEnd(const Term&) { return false; }
+double GetData(const Term& t) { return t.value; }
+double Init(TERM) { return 0; }
+TERM GetType(const Term& t) { return t.type; }
+
+using AST = STree< Term, map< TERM, int > >;
+
+///Scoped visitor: records maximum depth
+struct Depth {
+    int depth = 0;
+    int max = 0;
+    Depth& operator()(const Term&, APPLY a) {
+        if(a == APPLY::BEGIN) max = std::max(max, ++depth);
+        else --depth;
+        return *this;
+    }
+};
+
+using Clock = chrono::steady_clock;
+
+double Ms(Clock::time_point start) {
+    return chrono::duration< double, milli >(Clock::now() - start).count();
+}
+
+///Times traversals of tree, prints elapsed time and results
+void Run(const string& label, AST& ast, double build) {
+    using Op = function< double (double, double) >;
+    const map< TERM, Op > ops = {
+        {NUMBER, [](double n, double) { return n; }},
+        {PLUS, [](double v1, double v2) { return v1 + v2; }}
+    };
+    auto start = Clock::now();
+    size_t nodes = 0;
+    ast.Apply([&nodes](const Term&) { ++nodes; });
+    const double apply = Ms(start);
+    start = Clock::now();
+    const Depth d = ast.ScopedApply(Depth());
+    const double scoped = Ms(start);
+    start = Clock::now();
+    const double r = ast.Eval(ops);
+    const double eval = Ms(start);
+    cout << label << ": " << nodes << " nodes, depth " << d.max
+         << ", value " << r << '\n'
+         << "  build " << build << " ms, apply " << apply
+         << " ms, scoped apply " << scoped << " ms, eval " << eval
+         << " ms" << endl;
+}
+
+}
+
+///Entry point
+int main(int argc, char** argv) {
+    const int nodes = argc > 1 ? atoi(argv[1]) : 1000000;
+    AST ast(map< TERM, int >{{NUMBER, 10}, {PLUS, 5}});
+    //1+1+...+1
+    auto start = Clock::now();
+    for(int i = 0; i != nodes / 2; ++i) {
+        if(i) ast.Add({PLUS, 0});
+        ast.Add({NUMBER, 1});
+    }
+    Run("long sum", ast, Ms(start));
+    ast.Reset();
+    //chain: each term has a higher weight than the previous one
+    start = Clock::now();
+    for(int i = 0; i != nodes; ++i) ast.Add({NUMBER, 1}, i, false);
+    Run("chain   ", ast, Ms(start));
+    return 0;
+}
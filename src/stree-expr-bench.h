@@ -0,0 +1,93 @@
+#pragma once
+//Syntax tree, expression and evaluation functions shared by the STree
+//evaluation benchmarks
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include <STree.h>
+#include <types.h>
+
+namespace streebench {
+//==============================================================================
+using namespace parsley;
+using real_t = double;
+
+enum TERM {OP = 1, CP, PLUS, MINUS, MUL, DIV, POW, NUMBER, VAR};
+
+///Operator priority, same as math-parser
+inline std::map< TERM, int > Weights() {
+    return GenWeightedTerms< TERM, int >(
+        {{PLUS},
+        {MINUS},
+        {MUL, DIV},
+        {POW},
+        {VAR, NUMBER}},
+        //scope operators
+        {OP, CP});
+}
+
+struct Term {
+    TERM type;
+    real_t value;
+};
+
+//required customization points
+inline bool ScopeBegin(const Term&) { return false; }
+inline bool ScopeEnd(const Term&) { return false; }
+inline real_t GetData(const Term& t) { return t.value; }
+inline real_t Init(TERM t) { return t == MUL || t == DIV || t == POW ? 1 : 0; }
+inline TERM GetType(const Term& t) { return t.type; }
+
+using AST = STree< Term, std::map< TERM, int > >;
+
+///Returns terms of (x + 1) * (y - 2) + x * y / 3 - 2 * x ^ 2 in parsing
+///order, x and y are variables in slots zero and one
+inline std::vector< Term > Terms() {
+    const Term X = {VAR, 0};
+    const Term Y = {VAR, 1};
+    auto N = [](real_t v) { return Term{NUMBER, v}; };
+    return {
+        {OP, 0}, X, {PLUS, 0}, N(1), {CP, 0}, {MUL, 0},
+        {OP, 0}, Y, {MINUS, 0}, N(2), {CP, 0},
+        {PLUS, 0}, X, {MUL, 0}, Y, {DIV, 0}, N(3),
+        {MINUS, 0}, N(2), {MUL, 0}, X, {POW, 0}, N(2)
+    };
+}
+
+///Adds terms to tree the same way the math-parser callback does,
+///parentheses change the weight offset only
+inline void Build(AST& ast, const std::vector< Term >& terms) {
+    for(auto& t: terms) {
+        if(t.type == OP) ast.OffsetInc(OP);
+        else if(t.type == CP) ast.OffsetDec(CP);
+        else ast.Add(t);
+    }
+}
+
+using Op = std::function< real_t (real_t, real_t) >;
+
+///Returns evaluation functions, variables are read from vars
+inline std::map< TERM, Op > Ops(const std::vector< real_t >& vars) {
+    return {
+        {NUMBER, [](real_t n, real_t) { return n; }},
+        {VAR, [&vars](real_t k, real_t) { return vars[size_t(k)]; }},
+        {PLUS, [](real_t v1, real_t v2) { return v1 + v2; }},
+        {MINUS, [](real_t v1, real_t v2) { return v1 - v2; }},
+        {MUL, [](real_t v1, real_t v2) { return v1 * v2; }},
+        {DIV, [](real_t v1, real_t v2) { return v1 / v2; }},
+        {POW, [](real_t v1, real_t v2) { return std::pow(v1, v2); }}
+    };
+}
+
+using Clock = std::chrono::steady_clock;
+
+inline double Ms(Clock::time_point start) {
+    return std::chrono::duration< double, std::milli >(
+               Clock::now() - start).count();
+}
+
+}
@@ -0,0 +1,46 @@
+//Benchmark: repeated evaluation of a syntax tree with different variable
+//values, STree::Eval vs compiled postfix Program
+//Usage: stree-program-bench [number of evaluations]
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <STProgram.h>
+#include "stree-expr-bench.h"
+
+using namespace std;
+using namespace streebench;
+
+///Entry point
+int main(int argc, char** argv) {
+    const int evaluations = argc > 1 ? atoi(argv[1]) : 1000000;
+    AST ast(Weights());
+    Build(ast, Terms());
+    vector< real_t > vars(2);
+    const auto ops = Ops(vars);
+    auto start = Clock::now();
+    real_t sumEval = 0;
+    for(int i = 0; i != evaluations; ++i) {
+        vars[0] = i * 0.001;
+        vars[1] = 1 - i * 0.002;
+        sumEval += ast.Eval(ops);
+    }
+    const double eval = Ms(start);
+    auto p = CompileEval(ast.GetTree(), ops, [](const Term& t) {
+        return t.type == VAR ? int(t.value) : -1;
+    });
+    start = Clock::now();
+    real_t sumRun = 0;
+    for(int i = 0; i != evaluations; ++i) {
+        vars[0] = i * 0.001;
+        vars[1] = 1 - i * 0.002;
+        sumRun += p.Run(vars.data());
+    }
+    const double run = Ms(start);
+    cout << "tree eval: " << eval << " ms, sum " << sumEval << '\n'
+         << "program:   " << run << " ms, sum " << sumRun << ", "
+         << p.GetCode().size() << " instructions, stack size "
+         << p.StackSize() << endl;
+    return sumEval == sumRun ? 0 : 1;
+}